@@ -0,0 +1,1156 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Charles J. Cliffe
+ * Copyright (c) 2020 Franco Venturi - changes for SDRplay API version 3
+ *                                     and Dual Tuner for RSPduo
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "Conversion.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CONVERSION_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CONVERSION_TARGET(isa)
+#else
+#define CONVERSION_TARGET(isa) __attribute__((target(isa)))
+#endif
+#elif defined(ENABLE_NEON) && (defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON))
+// not yet tested on ARM hardware, hence only with -DENABLE_NEON=ON
+#define CONVERSION_NEON
+#include <arm_neon.h>
+#endif
+
+// CF32 full scale is 32768 as in the original conversion
+static const float cf32Scale = 1.0f / 32768.0f;
+static const float cs16Scale = 32768.0f;
+
+static const double twoPi = 6.283185307179586;
+
+// the frequency shift kernels run the oscillator in single precision,
+// rotating it sample by sample (or by several samples for all the lanes
+// of a vector at a time); they restart it from the double precision
+// phase every ncoBlock samples so that the rounding errors do not add up
+static const unsigned int ncoBlock = 1024;
+
+// the oscillator for 'lanes' consecutive samples, and its rotation
+// (cosine and sine) over 'lanes' samples
+static inline void ncoStart(const SoapySDRPlayNco *nco, unsigned int lanes, float *c, float *s, float *rotation)
+{
+    const double stepC = std::cos(twoPi * nco->step);
+    const double stepS = std::sin(twoPi * nco->step);
+    double pc = std::cos(twoPi * nco->phase);
+    double ps = std::sin(twoPi * nco->phase);
+    double rc = 1;
+    double rs = 0;
+    for (unsigned int k = 0; k < lanes; k++)
+    {
+        c[k] = (float)pc;
+        s[k] = (float)ps;
+        const double nc = pc * stepC - ps * stepS;
+        ps = pc * stepS + ps * stepC;
+        pc = nc;
+        const double nr = rc * stepC - rs * stepS;
+        rs = rc * stepS + rs * stepC;
+        rc = nr;
+    }
+    rotation[0] = (float)rc;
+    rotation[1] = (float)rs;
+}
+
+/*******************************************************************
+ * Scalar kernels
+ ******************************************************************/
+
+static void toCS16_scalar(const short *xi, const short *xq, void *out, unsigned int numSamples)
+{
+    short *dptr = (short *)out;
+    for (unsigned int i = 0; i < numSamples; i++)
+    {
+        *dptr++ = xi[i];
+        *dptr++ = xq[i];
+    }
+}
+
+static void toCF32_scalar(const short *xi, const short *xq, void *out, unsigned int numSamples)
+{
+    float *dptr = (float *)out;
+    for (unsigned int i = 0; i < numSamples; i++)
+    {
+        *dptr++ = (float)xi[i] * cf32Scale;
+        *dptr++ = (float)xq[i] * cf32Scale;
+    }
+}
+
+static void cs16ToCF32_scalar(const short *in, void *out, unsigned int numSamples)
+{
+    float *dptr = (float *)out;
+    for (unsigned int i = 0; i < 2 * numSamples; i++)
+    {
+        dptr[i] = (float)in[i] * cf32Scale;
+    }
+}
+
+static void toCS12_scalar(const short *xi, const short *xq, void *out, unsigned int numSamples)
+{
+    unsigned char *dptr = (unsigned char *)out;
+    for (unsigned int i = 0; i < numSamples; i++)
+    {
+        const unsigned short ui = (unsigned short)xi[i];
+        const unsigned short uq = (unsigned short)xq[i];
+        *dptr++ = (unsigned char)(ui >> 4);
+        *dptr++ = (unsigned char)((uq & 0xf0) | (ui >> 12));
+        *dptr++ = (unsigned char)(uq >> 8);
+    }
+}
+
+// the SIMD kernels add the rounding constant with 16 bit saturation,
+// which gives the same result after the 8 bit saturation for shifts up to 8
+static inline signed char roundToCS8(int value, int round, unsigned int shift)
+{
+    return (signed char)std::min(std::max(std::min(value + round, 32767) >> shift, -128), 127);
+}
+
+static void toCS8_scalar(const short *xi, const short *xq, void *out, unsigned int numSamples, unsigned int shift)
+{
+    signed char *dptr = (signed char *)out;
+    const int round = shift != 0 ? 1 << (shift - 1) : 0;
+    for (unsigned int i = 0; i < numSamples; i++)
+    {
+        *dptr++ = roundToCS8(xi[i], round, shift);
+        *dptr++ = roundToCS8(xq[i], round, shift);
+    }
+}
+
+static unsigned int peak_scalar(const short *xi, const short *xq, unsigned int numSamples)
+{
+    int peak = 0;
+    for (unsigned int i = 0; i < numSamples; i++)
+    {
+        peak = std::max(peak, std::abs((int)xi[i]));
+        peak = std::max(peak, std::abs((int)xq[i]));
+    }
+    return (unsigned int)peak;
+}
+
+static void halfBand_scalar(const float *even, const float *odd, const float *taps, unsigned int numTaps,
+                            float center, float *out, unsigned int numOutputs)
+{
+    const unsigned int k0 = numTaps - 1;
+    for (unsigned int m = 0; m < numOutputs; m++)
+    {
+        float accI = center * odd[2 * (m + k0)];
+        float accQ = center * odd[2 * (m + k0) + 1];
+        for (unsigned int k = 0; k < numTaps; k++)
+        {
+            accI += taps[k] * (even[2 * (m + k0 - k)] + even[2 * (m + numTaps + k)]);
+            accQ += taps[k] * (even[2 * (m + k0 - k) + 1] + even[2 * (m + numTaps + k) + 1]);
+        }
+        out[2 * m] = accI;
+        out[2 * m + 1] = accQ;
+    }
+}
+
+static void dot_scalar(const float *taps, const float *x, unsigned int numTaps, float *out)
+{
+    float accI = 0;
+    float accQ = 0;
+    for (unsigned int t = 0; t < numTaps; t++)
+    {
+        accI += taps[2 * t] * x[2 * t];
+        accQ += taps[2 * t + 1] * x[2 * t + 1];
+    }
+    out[0] = accI;
+    out[1] = accQ;
+}
+
+static void split_scalar(const float *in, float *even, float *odd, unsigned int numSamples)
+{
+    unsigned int i = 0;
+    for (; i + 2 <= numSamples; i += 2)
+    {
+        even[i] = in[2 * i];
+        even[i + 1] = in[2 * i + 1];
+        odd[i] = in[2 * i + 2];
+        odd[i + 1] = in[2 * i + 3];
+    }
+    if (i < numSamples)
+    {
+        even[i] = in[2 * i];
+        even[i + 1] = in[2 * i + 1];
+    }
+}
+
+static inline short roundToCS16(float value)
+{
+    return (short)std::min(std::max(std::lrint(value), -32768L), 32767L);
+}
+
+static void fromCF32_scalar(const float *in, short *outI, short *outQ, unsigned int numSamples)
+{
+    for (unsigned int i = 0; i < numSamples; i++)
+    {
+        outI[i] = roundToCS16(in[2 * i] * cs16Scale);
+        outQ[i] = roundToCS16(in[2 * i + 1] * cs16Scale);
+    }
+}
+
+// outI and outQ are 'stride' shorts apart from one sample to the next
+static inline void mixStrided(const short *xi, const short *xq, short *outI, short *outQ, unsigned int stride,
+                              unsigned int numSamples, SoapySDRPlayNco *nco)
+{
+    for (unsigned int start = 0; start < numSamples; start += ncoBlock)
+    {
+        const unsigned int end = std::min(start + ncoBlock, numSamples);
+        float c, s, rotation[2];
+        ncoStart(nco, 1, &c, &s, rotation);
+        for (unsigned int i = start; i < end; i++)
+        {
+            const float vi = xi[i];
+            const float vq = xq[i];
+            outI[i * stride] = roundToCS16(vi * c - vq * s);
+            outQ[i * stride] = roundToCS16(vi * s + vq * c);
+            const float nc = c * rotation[0] - s * rotation[1];
+            s = c * rotation[1] + s * rotation[0];
+            c = nc;
+        }
+        nco->advance(end - start);
+    }
+}
+
+static void mixToCS16_scalar(const short *xi, const short *xq, void *out, unsigned int numSamples, SoapySDRPlayNco *nco)
+{
+    short *dptr = (short *)out;
+    mixStrided(xi, xq, dptr, dptr + 1, 2, numSamples, nco);
+}
+
+static void mix_scalar(const short *xi, const short *xq, short *outI, short *outQ, unsigned int numSamples, SoapySDRPlayNco *nco)
+{
+    mixStrided(xi, xq, outI, outQ, 1, numSamples, nco);
+}
+
+#ifdef CONVERSION_X86
+
+/*******************************************************************
+ * SSE2 kernels
+ ******************************************************************/
+
+CONVERSION_TARGET("sse2")
+static void toCS16_sse2(const short *xi, const short *xq, void *out, unsigned int numSamples)
+{
+    short *dptr = (short *)out;
+    unsigned int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m128i vi = _mm_loadu_si128((const __m128i *)(xi + i));
+        __m128i vq = _mm_loadu_si128((const __m128i *)(xq + i));
+        _mm_storeu_si128((__m128i *)(dptr + 2 * i), _mm_unpacklo_epi16(vi, vq));
+        _mm_storeu_si128((__m128i *)(dptr + 2 * i + 8), _mm_unpackhi_epi16(vi, vq));
+    }
+    toCS16_scalar(xi + i, xq + i, dptr + 2 * i, numSamples - i);
+}
+
+CONVERSION_TARGET("sse2")
+static void toCF32_sse2(const short *xi, const short *xq, void *out, unsigned int numSamples)
+{
+    float *dptr = (float *)out;
+    const __m128 scale = _mm_set1_ps(cf32Scale);
+    unsigned int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m128i vi = _mm_loadu_si128((const __m128i *)(xi + i));
+        __m128i vq = _mm_loadu_si128((const __m128i *)(xq + i));
+        __m128i lo = _mm_unpacklo_epi16(vi, vq);
+        __m128i hi = _mm_unpackhi_epi16(vi, vq);
+        // sign extend to 32 bits by unpacking into the upper half
+        // and shifting back down
+        __m128i v0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16);
+        __m128i v1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16);
+        __m128i v2 = _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16);
+        __m128i v3 = _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16);
+        _mm_storeu_ps(dptr + 2 * i,      _mm_mul_ps(_mm_cvtepi32_ps(v0), scale));
+        _mm_storeu_ps(dptr + 2 * i + 4,  _mm_mul_ps(_mm_cvtepi32_ps(v1), scale));
+        _mm_storeu_ps(dptr + 2 * i + 8,  _mm_mul_ps(_mm_cvtepi32_ps(v2), scale));
+        _mm_storeu_ps(dptr + 2 * i + 12, _mm_mul_ps(_mm_cvtepi32_ps(v3), scale));
+    }
+    toCF32_scalar(xi + i, xq + i, dptr + 2 * i, numSamples - i);
+}
+
+CONVERSION_TARGET("sse2")
+static void cs16ToCF32_sse2(const short *in, void *out, unsigned int numSamples)
+{
+    float *dptr = (float *)out;
+    const __m128 scale = _mm_set1_ps(cf32Scale);
+    unsigned int i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + 2 * i));
+        __m128i v0 = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i v1 = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dptr + 2 * i,     _mm_mul_ps(_mm_cvtepi32_ps(v0), scale));
+        _mm_storeu_ps(dptr + 2 * i + 4, _mm_mul_ps(_mm_cvtepi32_ps(v1), scale));
+    }
+    cs16ToCF32_scalar(in + 2 * i, dptr + 2 * i, numSamples - i);
+}
+
+CONVERSION_TARGET("sse2")
+static void toCS12_sse2(const short *xi, const short *xq, void *out, unsigned int numSamples)
+{
+    unsigned char *dptr = (unsigned char *)out;
+    // I + Q * 4096 gives the 24 bits of a sample in each 32 bit lane
+    const __m128i weights = _mm_set1_epi32((4096 << 16) | 1);
+    const __m128i low = _mm_set1_epi64x(0x0000000000ffffffLL);
+    const __m128i high = _mm_set1_epi64x(0x0000ffffff000000LL);
+    unsigned int i = 0;
+    // each 8 byte store writes 2 bytes past its sample pair, which
+    // belong to the next samples: keep at least one sample for the tail
+    for (; i + 8 < numSamples; i += 8)
+    {
+        __m128i vi = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(xi + i)), 4);
+        __m128i vq = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(xq + i)), 4);
+        __m128i w0 = _mm_madd_epi16(_mm_unpacklo_epi16(vi, vq), weights);
+        __m128i w1 = _mm_madd_epi16(_mm_unpackhi_epi16(vi, vq), weights);
+        // two samples in the low 48 bits of each 64 bit lane
+        w0 = _mm_or_si128(_mm_and_si128(w0, low), _mm_and_si128(_mm_srli_epi64(w0, 8), high));
+        w1 = _mm_or_si128(_mm_and_si128(w1, low), _mm_and_si128(_mm_srli_epi64(w1, 8), high));
+        unsigned char *d = dptr + 3 * i;
+        _mm_storel_epi64((__m128i *)d, w0);
+        _mm_storel_epi64((__m128i *)(d + 6), _mm_unpackhi_epi64(w0, w0));
+        _mm_storel_epi64((__m128i *)(d + 12), w1);
+        _mm_storel_epi64((__m128i *)(d + 18), _mm_unpackhi_epi64(w1, w1));
+    }
+    toCS12_scalar(xi + i, xq + i, dptr + 3 * i, numSamples - i);
+}
+
+CONVERSION_TARGET("sse2")
+static void toCS8_sse2(const short *xi, const short *xq, void *out, unsigned int numSamples, unsigned int shift)
+{
+    signed char *dptr = (signed char *)out;
+    const __m128i round = _mm_set1_epi16(shift != 0 ? (short)(1 << (shift - 1)) : 0);
+    const __m128i count = _mm_cvtsi32_si128((int)shift);
+    unsigned int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m128i vi = _mm_sra_epi16(_mm_adds_epi16(_mm_loadu_si128((const __m128i *)(xi + i)), round), count);
+        __m128i vq = _mm_sra_epi16(_mm_adds_epi16(_mm_loadu_si128((const __m128i *)(xq + i)), round), count);
+        // interleave as 16 bit values, then narrow with saturation
+        __m128i lo = _mm_unpacklo_epi16(vi, vq);
+        __m128i hi = _mm_unpackhi_epi16(vi, vq);
+        _mm_storeu_si128((__m128i *)(dptr + 2 * i), _mm_packs_epi16(lo, hi));
+    }
+    toCS8_scalar(xi + i, xq + i, dptr + 2 * i, numSamples - i, shift);
+}
+
+CONVERSION_TARGET("sse2")
+static unsigned int peak_sse2(const short *xi, const short *xq, unsigned int numSamples)
+{
+    __m128i vmax = _mm_setzero_si128();
+    __m128i vmin = _mm_setzero_si128();
+    unsigned int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m128i vi = _mm_loadu_si128((const __m128i *)(xi + i));
+        __m128i vq = _mm_loadu_si128((const __m128i *)(xq + i));
+        vmax = _mm_max_epi16(vmax, _mm_max_epi16(vi, vq));
+        vmin = _mm_min_epi16(vmin, _mm_min_epi16(vi, vq));
+    }
+    // the magnitude of the minimum may not fit in 16 bits
+    short maxs[8];
+    short mins[8];
+    _mm_storeu_si128((__m128i *)maxs, vmax);
+    _mm_storeu_si128((__m128i *)mins, vmin);
+    int peak = (int)peak_scalar(xi + i, xq + i, numSamples - i);
+    for (int j = 0; j < 8; j++)
+    {
+        peak = std::max(peak, std::max((int)maxs[j], -(int)mins[j]));
+    }
+    return (unsigned int)peak;
+}
+CONVERSION_TARGET("sse2")
+static void halfBand_sse2(const float *even, const float *odd, const float *taps, unsigned int numTaps,
+                          float center, float *out, unsigned int numOutputs)
+{
+    const unsigned int k0 = numTaps - 1;
+    const __m128 c = _mm_set1_ps(center);
+    unsigned int m = 0;
+    for (; m + 2 <= numOutputs; m += 2)
+    {
+        __m128 acc = _mm_mul_ps(c, _mm_loadu_ps(odd + 2 * (m + k0)));
+        for (unsigned int k = 0; k < numTaps; k++)
+        {
+            __m128 x = _mm_add_ps(_mm_loadu_ps(even + 2 * (m + k0 - k)), _mm_loadu_ps(even + 2 * (m + numTaps + k)));
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(taps[k]), x));
+        }
+        _mm_storeu_ps(out + 2 * m, acc);
+    }
+    halfBand_scalar(even + 2 * m, odd + 2 * m, taps, numTaps, center, out + 2 * m, numOutputs - m);
+}
+
+CONVERSION_TARGET("sse2")
+static void dot_sse2(const float *taps, const float *x, unsigned int numTaps, float *out)
+{
+    __m128 acc = _mm_setzero_ps();
+    for (unsigned int t = 0; t < numTaps; t += 2)
+    {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(taps + 2 * t), _mm_loadu_ps(x + 2 * t)));
+    }
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    out[0] = _mm_cvtss_f32(acc);
+    out[1] = _mm_cvtss_f32(_mm_shuffle_ps(acc, acc, 1));
+}
+
+CONVERSION_TARGET("sse2")
+static void split_sse2(const float *in, float *even, float *odd, unsigned int numSamples)
+{
+    unsigned int i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        __m128 a0 = _mm_loadu_ps(in + 2 * i);
+        __m128 a1 = _mm_loadu_ps(in + 2 * i + 4);
+        _mm_storeu_ps(even + i, _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(1, 0, 1, 0)));
+        _mm_storeu_ps(odd + i, _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 2, 3, 2)));
+    }
+    split_scalar(in + 2 * i, even + i, odd + i, numSamples - i);
+}
+
+// scaled to 16 bits, saturated and rounded to nearest (as 32 bit values)
+CONVERSION_TARGET("sse2")
+static inline __m128i roundToCS16_sse2(__m128 v)
+{
+    v = _mm_mul_ps(v, _mm_set1_ps(cs16Scale));
+    v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-32768.0f)), _mm_set1_ps(32767.0f));
+    return _mm_cvtps_epi32(v);
+}
+
+CONVERSION_TARGET("sse2")
+static void fromCF32_sse2(const float *in, short *outI, short *outQ, unsigned int numSamples)
+{
+    unsigned int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m128 a0 = _mm_loadu_ps(in + 2 * i);
+        __m128 a1 = _mm_loadu_ps(in + 2 * i + 4);
+        __m128 a2 = _mm_loadu_ps(in + 2 * i + 8);
+        __m128 a3 = _mm_loadu_ps(in + 2 * i + 12);
+        __m128i i0 = roundToCS16_sse2(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i q0 = roundToCS16_sse2(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1)));
+        __m128i i1 = roundToCS16_sse2(_mm_shuffle_ps(a2, a3, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i q1 = roundToCS16_sse2(_mm_shuffle_ps(a2, a3, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm_storeu_si128((__m128i *)(outI + i), _mm_packs_epi32(i0, i1));
+        _mm_storeu_si128((__m128i *)(outQ + i), _mm_packs_epi32(q0, q1));
+    }
+    fromCF32_scalar(in + 2 * i, outI + i, outQ + i, numSamples - i);
+}
+
+// frequency shift of 8 samples with the oscillator for the first 4 in
+// c and s, which then move on by 8 samples (rc and rs rotate them by 4)
+CONVERSION_TARGET("sse2")
+static inline void mix8_sse2(__m128i &vi, __m128i &vq, __m128 &c, __m128 &s, const __m128 rc, const __m128 rs)
+{
+    __m128 i0 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(vi, vi), 16));
+    __m128 i1 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(vi, vi), 16));
+    __m128 q0 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(vq, vq), 16));
+    __m128 q1 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(vq, vq), 16));
+    __m128 c1 = _mm_sub_ps(_mm_mul_ps(c, rc), _mm_mul_ps(s, rs));
+    __m128 s1 = _mm_add_ps(_mm_mul_ps(c, rs), _mm_mul_ps(s, rc));
+    // round to nearest and saturate to 16 bits
+    __m128i mi0 = _mm_cvtps_epi32(_mm_sub_ps(_mm_mul_ps(i0, c), _mm_mul_ps(q0, s)));
+    __m128i mq0 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(i0, s), _mm_mul_ps(q0, c)));
+    __m128i mi1 = _mm_cvtps_epi32(_mm_sub_ps(_mm_mul_ps(i1, c1), _mm_mul_ps(q1, s1)));
+    __m128i mq1 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(i1, s1), _mm_mul_ps(q1, c1)));
+    vi = _mm_packs_epi32(mi0, mi1);
+    vq = _mm_packs_epi32(mq0, mq1);
+    c = _mm_sub_ps(_mm_mul_ps(c1, rc), _mm_mul_ps(s1, rs));
+    s = _mm_add_ps(_mm_mul_ps(c1, rs), _mm_mul_ps(s1, rc));
+}
+
+CONVERSION_TARGET("sse2")
+static void mixToCS16_sse2(const short *xi, const short *xq, void *out, unsigned int numSamples, SoapySDRPlayNco *nco)
+{
+    short *dptr = (short *)out;
+    unsigned int i = 0;
+    while (i + 8 <= numSamples)
+    {
+        const unsigned int start = i;
+        const unsigned int end = std::min(start + ncoBlock, numSamples & ~7u);
+        float c[4], s[4], rotation[2];
+        ncoStart(nco, 4, c, s, rotation);
+        __m128 vc = _mm_loadu_ps(c);
+        __m128 vs = _mm_loadu_ps(s);
+        const __m128 rc = _mm_set1_ps(rotation[0]);
+        const __m128 rs = _mm_set1_ps(rotation[1]);
+        for (; i < end; i += 8)
+        {
+            __m128i vi = _mm_loadu_si128((const __m128i *)(xi + i));
+            __m128i vq = _mm_loadu_si128((const __m128i *)(xq + i));
+            mix8_sse2(vi, vq, vc, vs, rc, rs);
+            _mm_storeu_si128((__m128i *)(dptr + 2 * i), _mm_unpacklo_epi16(vi, vq));
+            _mm_storeu_si128((__m128i *)(dptr + 2 * i + 8), _mm_unpackhi_epi16(vi, vq));
+        }
+        nco->advance(end - start);
+    }
+    mixToCS16_scalar(xi + i, xq + i, dptr + 2 * i, numSamples - i, nco);
+}
+
+CONVERSION_TARGET("sse2")
+static void mix_sse2(const short *xi, const short *xq, short *outI, short *outQ, unsigned int numSamples, SoapySDRPlayNco *nco)
+{
+    unsigned int i = 0;
+    while (i + 8 <= numSamples)
+    {
+        const unsigned int start = i;
+        const unsigned int end = std::min(start + ncoBlock, numSamples & ~7u);
+        float c[4], s[4], rotation[2];
+        ncoStart(nco, 4, c, s, rotation);
+        __m128 vc = _mm_loadu_ps(c);
+        __m128 vs = _mm_loadu_ps(s);
+        const __m128 rc = _mm_set1_ps(rotation[0]);
+        const __m128 rs = _mm_set1_ps(rotation[1]);
+        for (; i < end; i += 8)
+        {
+            __m128i vi = _mm_loadu_si128((const __m128i *)(xi + i));
+            __m128i vq = _mm_loadu_si128((const __m128i *)(xq + i));
+            mix8_sse2(vi, vq, vc, vs, rc, rs);
+            _mm_storeu_si128((__m128i *)(outI + i), vi);
+            _mm_storeu_si128((__m128i *)(outQ + i), vq);
+        }
+        nco->advance(end - start);
+    }
+    mix_scalar(xi + i, xq + i, outI + i, outQ + i, numSamples - i, nco);
+}
+
+
+/*******************************************************************
+ * AVX2 kernels
+ ******************************************************************/
+
+CONVERSION_TARGET("avx2")
+static void toCS16_avx2(const short *xi, const short *xq, void *out, unsigned int numSamples)
+{
+    short *dptr = (short *)out;
+    unsigned int i = 0;
+    for (; i + 16 <= numSamples; i += 16)
+    {
+        __m256i vi = _mm256_loadu_si256((const __m256i *)(xi + i));
+        __m256i vq = _mm256_loadu_si256((const __m256i *)(xq + i));
+        // unpack works within each 128 bit lane, so put the lanes
+        // back in order afterwards
+        __m256i lo = _mm256_unpacklo_epi16(vi, vq);
+        __m256i hi = _mm256_unpackhi_epi16(vi, vq);
+        _mm256_storeu_si256((__m256i *)(dptr + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(dptr + 2 * i + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    toCS16_sse2(xi + i, xq + i, dptr + 2 * i, numSamples - i);
+}
+
+CONVERSION_TARGET("avx2")
+static void toCF32_avx2(const short *xi, const short *xq, void *out, unsigned int numSamples)
+{
+    float *dptr = (float *)out;
+    const __m256 scale = _mm256_set1_ps(cf32Scale);
+    unsigned int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m128i vi = _mm_loadu_si128((const __m128i *)(xi + i));
+        __m128i vq = _mm_loadu_si128((const __m128i *)(xq + i));
+        __m256i v0 = _mm256_cvtepi16_epi32(_mm_unpacklo_epi16(vi, vq));
+        __m256i v1 = _mm256_cvtepi16_epi32(_mm_unpackhi_epi16(vi, vq));
+        _mm256_storeu_ps(dptr + 2 * i,     _mm256_mul_ps(_mm256_cvtepi32_ps(v0), scale));
+        _mm256_storeu_ps(dptr + 2 * i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(v1), scale));
+    }
+    toCF32_scalar(xi + i, xq + i, dptr + 2 * i, numSamples - i);
+}
+
+CONVERSION_TARGET("avx2")
+static void cs16ToCF32_avx2(const short *in, void *out, unsigned int numSamples)
+{
+    float *dptr = (float *)out;
+    const __m256 scale = _mm256_set1_ps(cf32Scale);
+    unsigned int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m256i v0 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(in + 2 * i)));
+        __m256i v1 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(in + 2 * i + 8)));
+        _mm256_storeu_ps(dptr + 2 * i,     _mm256_mul_ps(_mm256_cvtepi32_ps(v0), scale));
+        _mm256_storeu_ps(dptr + 2 * i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(v1), scale));
+    }
+    cs16ToCF32_scalar(in + 2 * i, dptr + 2 * i, numSamples - i);
+}
+
+CONVERSION_TARGET("avx2")
+static void toCS12_avx2(const short *xi, const short *xq, void *out, unsigned int numSamples)
+{
+    unsigned char *dptr = (unsigned char *)out;
+    // the 3 low bytes of each 32 bit lane, packed at the start of each 128 bit lane
+    const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    unsigned int i = 0;
+    // each 16 byte store writes 4 bytes past its 4 samples, which
+    // belong to the next samples: keep at least two samples for the tail
+    for (; i + 10 <= numSamples; i += 8)
+    {
+        __m256i vi = _mm256_cvtepu16_epi32(_mm_srli_epi16(_mm_loadu_si128((const __m128i *)(xi + i)), 4));
+        __m256i vq = _mm256_cvtepu16_epi32(_mm_srli_epi16(_mm_loadu_si128((const __m128i *)(xq + i)), 4));
+        __m256i w = _mm256_shuffle_epi8(_mm256_or_si256(vi, _mm256_slli_epi32(vq, 12)), pack);
+        unsigned char *d = dptr + 3 * i;
+        _mm_storeu_si128((__m128i *)d, _mm256_castsi256_si128(w));
+        _mm_storeu_si128((__m128i *)(d + 12), _mm256_extracti128_si256(w, 1));
+    }
+    toCS12_sse2(xi + i, xq + i, dptr + 3 * i, numSamples - i);
+}
+
+CONVERSION_TARGET("avx2")
+static void toCS8_avx2(const short *xi, const short *xq, void *out, unsigned int numSamples, unsigned int shift)
+{
+    signed char *dptr = (signed char *)out;
+    const __m256i round = _mm256_set1_epi16(shift != 0 ? (short)(1 << (shift - 1)) : 0);
+    const __m128i count = _mm_cvtsi32_si128((int)shift);
+    unsigned int i = 0;
+    for (; i + 16 <= numSamples; i += 16)
+    {
+        __m256i vi = _mm256_sra_epi16(_mm256_adds_epi16(_mm256_loadu_si256((const __m256i *)(xi + i)), round), count);
+        __m256i vq = _mm256_sra_epi16(_mm256_adds_epi16(_mm256_loadu_si256((const __m256i *)(xq + i)), round), count);
+        // unpack and pack both work within each 128 bit lane,
+        // so the samples come out in order
+        __m256i lo = _mm256_unpacklo_epi16(vi, vq);
+        __m256i hi = _mm256_unpackhi_epi16(vi, vq);
+        _mm256_storeu_si256((__m256i *)(dptr + 2 * i), _mm256_packs_epi16(lo, hi));
+    }
+    toCS8_sse2(xi + i, xq + i, dptr + 2 * i, numSamples - i, shift);
+}
+
+CONVERSION_TARGET("avx2")
+static unsigned int peak_avx2(const short *xi, const short *xq, unsigned int numSamples)
+{
+    __m256i vmax = _mm256_setzero_si256();
+    __m256i vmin = _mm256_setzero_si256();
+    unsigned int i = 0;
+    for (; i + 16 <= numSamples; i += 16)
+    {
+        __m256i vi = _mm256_loadu_si256((const __m256i *)(xi + i));
+        __m256i vq = _mm256_loadu_si256((const __m256i *)(xq + i));
+        vmax = _mm256_max_epi16(vmax, _mm256_max_epi16(vi, vq));
+        vmin = _mm256_min_epi16(vmin, _mm256_min_epi16(vi, vq));
+    }
+    short maxs[16];
+    short mins[16];
+    _mm256_storeu_si256((__m256i *)maxs, vmax);
+    _mm256_storeu_si256((__m256i *)mins, vmin);
+    int peak = (int)peak_sse2(xi + i, xq + i, numSamples - i);
+    for (int j = 0; j < 16; j++)
+    {
+        peak = std::max(peak, std::max((int)maxs[j], -(int)mins[j]));
+    }
+    return (unsigned int)peak;
+}
+
+CONVERSION_TARGET("avx2")
+static void halfBand_avx2(const float *even, const float *odd, const float *taps, unsigned int numTaps,
+                          float center, float *out, unsigned int numOutputs)
+{
+    const unsigned int k0 = numTaps - 1;
+    const __m256 c = _mm256_set1_ps(center);
+    unsigned int m = 0;
+    for (; m + 4 <= numOutputs; m += 4)
+    {
+        __m256 acc = _mm256_mul_ps(c, _mm256_loadu_ps(odd + 2 * (m + k0)));
+        for (unsigned int k = 0; k < numTaps; k++)
+        {
+            __m256 x = _mm256_add_ps(_mm256_loadu_ps(even + 2 * (m + k0 - k)), _mm256_loadu_ps(even + 2 * (m + numTaps + k)));
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(taps[k]), x));
+        }
+        _mm256_storeu_ps(out + 2 * m, acc);
+    }
+    halfBand_scalar(even + 2 * m, odd + 2 * m, taps, numTaps, center, out + 2 * m, numOutputs - m);
+}
+
+CONVERSION_TARGET("avx2")
+static void dot_avx2(const float *taps, const float *x, unsigned int numTaps, float *out)
+{
+    __m256 acc = _mm256_setzero_ps();
+    for (unsigned int t = 0; t < numTaps; t += 4)
+    {
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(taps + 2 * t), _mm256_loadu_ps(x + 2 * t)));
+    }
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    out[0] = _mm_cvtss_f32(sum);
+    out[1] = _mm_cvtss_f32(_mm_shuffle_ps(sum, sum, 1));
+}
+
+CONVERSION_TARGET("avx2")
+static void split_avx2(const float *in, float *even, float *odd, unsigned int numSamples)
+{
+    unsigned int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m256 a0 = _mm256_loadu_ps(in + 2 * i);
+        __m256 a1 = _mm256_loadu_ps(in + 2 * i + 8);
+        // shuffle works within each 128 bit lane, so put the samples
+        // (64 bit each) back in order afterwards
+        __m256d e = _mm256_castps_pd(_mm256_shuffle_ps(a0, a1, _MM_SHUFFLE(1, 0, 1, 0)));
+        __m256d o = _mm256_castps_pd(_mm256_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 2, 3, 2)));
+        _mm256_storeu_ps(even + i, _mm256_castpd_ps(_mm256_permute4x64_pd(e, 0xd8)));
+        _mm256_storeu_ps(odd + i, _mm256_castpd_ps(_mm256_permute4x64_pd(o, 0xd8)));
+    }
+    split_sse2(in + 2 * i, even + i, odd + i, numSamples - i);
+}
+
+// 8 values picked from two vectors by a shuffle (which works within
+// each 128 bit lane), put back in order, scaled to 16 bits, saturated
+// and rounded to nearest (as 32 bit values)
+CONVERSION_TARGET("avx2")
+static inline __m256i roundToCS16_avx2(__m256 v)
+{
+    v = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(v), 0xd8));
+    v = _mm256_mul_ps(v, _mm256_set1_ps(cs16Scale));
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(-32768.0f)), _mm256_set1_ps(32767.0f));
+    return _mm256_cvtps_epi32(v);
+}
+
+CONVERSION_TARGET("avx2")
+static void fromCF32_avx2(const float *in, short *outI, short *outQ, unsigned int numSamples)
+{
+    unsigned int i = 0;
+    for (; i + 16 <= numSamples; i += 16)
+    {
+        __m256 a0 = _mm256_loadu_ps(in + 2 * i);
+        __m256 a1 = _mm256_loadu_ps(in + 2 * i + 8);
+        __m256 a2 = _mm256_loadu_ps(in + 2 * i + 16);
+        __m256 a3 = _mm256_loadu_ps(in + 2 * i + 24);
+        __m256i i0 = roundToCS16_avx2(_mm256_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m256i q0 = roundToCS16_avx2(_mm256_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1)));
+        __m256i i1 = roundToCS16_avx2(_mm256_shuffle_ps(a2, a3, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m256i q1 = roundToCS16_avx2(_mm256_shuffle_ps(a2, a3, _MM_SHUFFLE(3, 1, 3, 1)));
+        // pack works within each 128 bit lane too
+        _mm256_storeu_si256((__m256i *)(outI + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(i0, i1), 0xd8));
+        _mm256_storeu_si256((__m256i *)(outQ + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(q0, q1), 0xd8));
+    }
+    fromCF32_sse2(in + 2 * i, outI + i, outQ + i, numSamples - i);
+}
+
+// frequency shift of 16 samples with the oscillator for the first 8 in
+// c and s, which then move on by 16 samples (rc and rs rotate them by 8)
+CONVERSION_TARGET("avx2")
+static inline void mix16_avx2(__m256i &vi, __m256i &vq, __m256 &c, __m256 &s, const __m256 rc, const __m256 rs)
+{
+    __m256 i0 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(vi)));
+    __m256 i1 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(vi, 1)));
+    __m256 q0 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(vq)));
+    __m256 q1 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(vq, 1)));
+    __m256 c1 = _mm256_sub_ps(_mm256_mul_ps(c, rc), _mm256_mul_ps(s, rs));
+    __m256 s1 = _mm256_add_ps(_mm256_mul_ps(c, rs), _mm256_mul_ps(s, rc));
+    __m256i mi0 = _mm256_cvtps_epi32(_mm256_sub_ps(_mm256_mul_ps(i0, c), _mm256_mul_ps(q0, s)));
+    __m256i mq0 = _mm256_cvtps_epi32(_mm256_add_ps(_mm256_mul_ps(i0, s), _mm256_mul_ps(q0, c)));
+    __m256i mi1 = _mm256_cvtps_epi32(_mm256_sub_ps(_mm256_mul_ps(i1, c1), _mm256_mul_ps(q1, s1)));
+    __m256i mq1 = _mm256_cvtps_epi32(_mm256_add_ps(_mm256_mul_ps(i1, s1), _mm256_mul_ps(q1, c1)));
+    // pack works within each 128 bit lane, so put the 64 bit
+    // quarters back in order afterwards
+    vi = _mm256_permute4x64_epi64(_mm256_packs_epi32(mi0, mi1), 0xd8);
+    vq = _mm256_permute4x64_epi64(_mm256_packs_epi32(mq0, mq1), 0xd8);
+    c = _mm256_sub_ps(_mm256_mul_ps(c1, rc), _mm256_mul_ps(s1, rs));
+    s = _mm256_add_ps(_mm256_mul_ps(c1, rs), _mm256_mul_ps(s1, rc));
+}
+
+CONVERSION_TARGET("avx2")
+static void mixToCS16_avx2(const short *xi, const short *xq, void *out, unsigned int numSamples, SoapySDRPlayNco *nco)
+{
+    short *dptr = (short *)out;
+    unsigned int i = 0;
+    while (i + 16 <= numSamples)
+    {
+        const unsigned int start = i;
+        const unsigned int end = std::min(start + ncoBlock, numSamples & ~15u);
+        float c[8], s[8], rotation[2];
+        ncoStart(nco, 8, c, s, rotation);
+        __m256 vc = _mm256_loadu_ps(c);
+        __m256 vs = _mm256_loadu_ps(s);
+        const __m256 rc = _mm256_set1_ps(rotation[0]);
+        const __m256 rs = _mm256_set1_ps(rotation[1]);
+        for (; i < end; i += 16)
+        {
+            __m256i vi = _mm256_loadu_si256((const __m256i *)(xi + i));
+            __m256i vq = _mm256_loadu_si256((const __m256i *)(xq + i));
+            mix16_avx2(vi, vq, vc, vs, rc, rs);
+            __m256i lo = _mm256_unpacklo_epi16(vi, vq);
+            __m256i hi = _mm256_unpackhi_epi16(vi, vq);
+            _mm256_storeu_si256((__m256i *)(dptr + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256((__m256i *)(dptr + 2 * i + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+        }
+        nco->advance(end - start);
+    }
+    mixToCS16_sse2(xi + i, xq + i, dptr + 2 * i, numSamples - i, nco);
+}
+
+CONVERSION_TARGET("avx2")
+static void mix_avx2(const short *xi, const short *xq, short *outI, short *outQ, unsigned int numSamples, SoapySDRPlayNco *nco)
+{
+    unsigned int i = 0;
+    while (i + 16 <= numSamples)
+    {
+        const unsigned int start = i;
+        const unsigned int end = std::min(start + ncoBlock, numSamples & ~15u);
+        float c[8], s[8], rotation[2];
+        ncoStart(nco, 8, c, s, rotation);
+        __m256 vc = _mm256_loadu_ps(c);
+        __m256 vs = _mm256_loadu_ps(s);
+        const __m256 rc = _mm256_set1_ps(rotation[0]);
+        const __m256 rs = _mm256_set1_ps(rotation[1]);
+        for (; i < end; i += 16)
+        {
+            __m256i vi = _mm256_loadu_si256((const __m256i *)(xi + i));
+            __m256i vq = _mm256_loadu_si256((const __m256i *)(xq + i));
+            mix16_avx2(vi, vq, vc, vs, rc, rs);
+            _mm256_storeu_si256((__m256i *)(outI + i), vi);
+            _mm256_storeu_si256((__m256i *)(outQ + i), vq);
+        }
+        nco->advance(end - start);
+    }
+    mix_sse2(xi + i, xq + i, outI + i, outQ + i, numSamples - i, nco);
+}
+
+static bool cpuSupports(const char *isa)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+    __cpuid(info, 1);
+    if (isa[0] == 's')
+    {
+        // sse2
+        return (info[3] & (1 << 26)) != 0;
+    }
+    // avx2 needs OS support for the ymm registers too
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || maxLeaf < 7 || (_xgetbv(0) & 0x6) != 0x6)
+    {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    if (isa[0] == 's')
+    {
+        return __builtin_cpu_supports("sse2");
+    }
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // CONVERSION_X86
+
+#ifdef CONVERSION_NEON
+
+/*******************************************************************
+ * NEON kernels
+ ******************************************************************/
+
+static void toCS16_neon(const short *xi, const short *xq, void *out, unsigned int numSamples)
+{
+    short *dptr = (short *)out;
+    unsigned int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        int16x8x2_t v;
+        v.val[0] = vld1q_s16(xi + i);
+        v.val[1] = vld1q_s16(xq + i);
+        vst2q_s16(dptr + 2 * i, v);
+    }
+    toCS16_scalar(xi + i, xq + i, dptr + 2 * i, numSamples - i);
+}
+
+static void toCF32_neon(const short *xi, const short *xq, void *out, unsigned int numSamples)
+{
+    float *dptr = (float *)out;
+    unsigned int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        int16x8_t vi = vld1q_s16(xi + i);
+        int16x8_t vq = vld1q_s16(xq + i);
+        float32x4x2_t lo, hi;
+        lo.val[0] = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(vi))), cf32Scale);
+        lo.val[1] = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(vq))), cf32Scale);
+        hi.val[0] = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(vi))), cf32Scale);
+        hi.val[1] = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(vq))), cf32Scale);
+        vst2q_f32(dptr + 2 * i, lo);
+        vst2q_f32(dptr + 2 * i + 8, hi);
+    }
+    toCF32_scalar(xi + i, xq + i, dptr + 2 * i, numSamples - i);
+}
+
+static void cs16ToCF32_neon(const short *in, void *out, unsigned int numSamples)
+{
+    float *dptr = (float *)out;
+    unsigned int i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        int16x8_t v = vld1q_s16(in + 2 * i);
+        vst1q_f32(dptr + 2 * i,     vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), cf32Scale));
+        vst1q_f32(dptr + 2 * i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), cf32Scale));
+    }
+    cs16ToCF32_scalar(in + 2 * i, dptr + 2 * i, numSamples - i);
+}
+
+static void toCS12_neon(const short *xi, const short *xq, void *out, unsigned int numSamples)
+{
+    unsigned char *dptr = (unsigned char *)out;
+    unsigned int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        uint16x8_t ui = vreinterpretq_u16_s16(vld1q_s16(xi + i));
+        uint16x8_t uq = vreinterpretq_u16_s16(vld1q_s16(xq + i));
+        uint8x8x3_t v;
+        v.val[0] = vshrn_n_u16(ui, 4);
+        v.val[1] = vmovn_u16(vorrq_u16(vandq_u16(uq, vdupq_n_u16(0xf0)), vshrq_n_u16(ui, 12)));
+        v.val[2] = vshrn_n_u16(uq, 8);
+        vst3_u8(dptr + 3 * i, v);
+    }
+    toCS12_scalar(xi + i, xq + i, dptr + 3 * i, numSamples - i);
+}
+
+static void toCS8_neon(const short *xi, const short *xq, void *out, unsigned int numSamples, unsigned int shift)
+{
+    signed char *dptr = (signed char *)out;
+    const int16x8_t round = vdupq_n_s16(shift != 0 ? (short)(1 << (shift - 1)) : 0);
+    const int16x8_t count = vdupq_n_s16(-(short)shift);
+    unsigned int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        int8x8x2_t v;
+        v.val[0] = vqmovn_s16(vshlq_s16(vqaddq_s16(vld1q_s16(xi + i), round), count));
+        v.val[1] = vqmovn_s16(vshlq_s16(vqaddq_s16(vld1q_s16(xq + i), round), count));
+        vst2_s8(dptr + 2 * i, v);
+    }
+    toCS8_scalar(xi + i, xq + i, dptr + 2 * i, numSamples - i, shift);
+}
+
+static unsigned int peak_neon(const short *xi, const short *xq, unsigned int numSamples)
+{
+    int16x8_t vmax = vdupq_n_s16(0);
+    int16x8_t vmin = vdupq_n_s16(0);
+    unsigned int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        int16x8_t vi = vld1q_s16(xi + i);
+        int16x8_t vq = vld1q_s16(xq + i);
+        vmax = vmaxq_s16(vmax, vmaxq_s16(vi, vq));
+        vmin = vminq_s16(vmin, vminq_s16(vi, vq));
+    }
+    short maxs[8];
+    short mins[8];
+    vst1q_s16(maxs, vmax);
+    vst1q_s16(mins, vmin);
+    int peak = (int)peak_scalar(xi + i, xq + i, numSamples - i);
+    for (int j = 0; j < 8; j++)
+    {
+        peak = std::max(peak, std::max((int)maxs[j], -(int)mins[j]));
+    }
+    return (unsigned int)peak;
+}
+
+
+static void halfBand_neon(const float *even, const float *odd, const float *taps, unsigned int numTaps,
+                          float center, float *out, unsigned int numOutputs)
+{
+    const unsigned int k0 = numTaps - 1;
+    unsigned int m = 0;
+    for (; m + 2 <= numOutputs; m += 2)
+    {
+        float32x4_t acc = vmulq_n_f32(vld1q_f32(odd + 2 * (m + k0)), center);
+        for (unsigned int k = 0; k < numTaps; k++)
+        {
+            float32x4_t x = vaddq_f32(vld1q_f32(even + 2 * (m + k0 - k)), vld1q_f32(even + 2 * (m + numTaps + k)));
+            acc = vmlaq_n_f32(acc, x, taps[k]);
+        }
+        vst1q_f32(out + 2 * m, acc);
+    }
+    halfBand_scalar(even + 2 * m, odd + 2 * m, taps, numTaps, center, out + 2 * m, numOutputs - m);
+}
+
+static void dot_neon(const float *taps, const float *x, unsigned int numTaps, float *out)
+{
+    float32x4_t acc = vdupq_n_f32(0);
+    for (unsigned int t = 0; t < numTaps; t += 2)
+    {
+        acc = vmlaq_f32(acc, vld1q_f32(taps + 2 * t), vld1q_f32(x + 2 * t));
+    }
+    vst1_f32(out, vadd_f32(vget_low_f32(acc), vget_high_f32(acc)));
+}
+
+// round to nearest and saturate to 16 bits
+static inline int16x4_t roundToCS16_neon(float32x4_t v)
+{
+#if defined(__aarch64__) || defined(_M_ARM64)
+    return vqmovn_s32(vcvtnq_s32_f32(v));
+#else
+    // ARMv7 only truncates: round half away from zero, which differs
+    // from the other kernels by one on exact ties
+    const float32x4_t half = vbslq_f32(vcltq_f32(v, vdupq_n_f32(0)), vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f));
+    return vqmovn_s32(vcvtq_s32_f32(vaddq_f32(v, half)));
+#endif
+}
+
+static void split_neon(const float *in, float *even, float *odd, unsigned int numSamples)
+{
+    unsigned int i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        float32x4_t a0 = vld1q_f32(in + 2 * i);
+        float32x4_t a1 = vld1q_f32(in + 2 * i + 4);
+        vst1q_f32(even + i, vcombine_f32(vget_low_f32(a0), vget_low_f32(a1)));
+        vst1q_f32(odd + i, vcombine_f32(vget_high_f32(a0), vget_high_f32(a1)));
+    }
+    split_scalar(in + 2 * i, even + i, odd + i, numSamples - i);
+}
+
+static void fromCF32_neon(const float *in, short *outI, short *outQ, unsigned int numSamples)
+{
+    unsigned int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        float32x4x2_t v0 = vld2q_f32(in + 2 * i);
+        float32x4x2_t v1 = vld2q_f32(in + 2 * i + 8);
+        vst1q_s16(outI + i, vcombine_s16(roundToCS16_neon(vmulq_n_f32(v0.val[0], cs16Scale)),
+                                         roundToCS16_neon(vmulq_n_f32(v1.val[0], cs16Scale))));
+        vst1q_s16(outQ + i, vcombine_s16(roundToCS16_neon(vmulq_n_f32(v0.val[1], cs16Scale)),
+                                         roundToCS16_neon(vmulq_n_f32(v1.val[1], cs16Scale))));
+    }
+    fromCF32_scalar(in + 2 * i, outI + i, outQ + i, numSamples - i);
+}
+
+// frequency shift of 8 samples with the oscillator for the first 4 in
+// c and s, which then move on by 8 samples (rc and rs rotate them by 4)
+static inline void mix8_neon(int16x8_t &vi, int16x8_t &vq, float32x4_t &c, float32x4_t &s, const float rc, const float rs)
+{
+    float32x4_t i0 = vcvtq_f32_s32(vmovl_s16(vget_low_s16(vi)));
+    float32x4_t i1 = vcvtq_f32_s32(vmovl_s16(vget_high_s16(vi)));
+    float32x4_t q0 = vcvtq_f32_s32(vmovl_s16(vget_low_s16(vq)));
+    float32x4_t q1 = vcvtq_f32_s32(vmovl_s16(vget_high_s16(vq)));
+    float32x4_t c1 = vmlsq_n_f32(vmulq_n_f32(c, rc), s, rs);
+    float32x4_t s1 = vmlaq_n_f32(vmulq_n_f32(c, rs), s, rc);
+    vi = vcombine_s16(roundToCS16_neon(vmlsq_f32(vmulq_f32(i0, c), q0, s)),
+                      roundToCS16_neon(vmlsq_f32(vmulq_f32(i1, c1), q1, s1)));
+    vq = vcombine_s16(roundToCS16_neon(vmlaq_f32(vmulq_f32(i0, s), q0, c)),
+                      roundToCS16_neon(vmlaq_f32(vmulq_f32(i1, s1), q1, c1)));
+    c = vmlsq_n_f32(vmulq_n_f32(c1, rc), s1, rs);
+    s = vmlaq_n_f32(vmulq_n_f32(c1, rs), s1, rc);
+}
+
+static void mixToCS16_neon(const short *xi, const short *xq, void *out, unsigned int numSamples, SoapySDRPlayNco *nco)
+{
+    short *dptr = (short *)out;
+    unsigned int i = 0;
+    while (i + 8 <= numSamples)
+    {
+        const unsigned int start = i;
+        const unsigned int end = std::min(start + ncoBlock, numSamples & ~7u);
+        float c[4], s[4], rotation[2];
+        ncoStart(nco, 4, c, s, rotation);
+        float32x4_t vc = vld1q_f32(c);
+        float32x4_t vs = vld1q_f32(s);
+        for (; i < end; i += 8)
+        {
+            int16x8x2_t v;
+            v.val[0] = vld1q_s16(xi + i);
+            v.val[1] = vld1q_s16(xq + i);
+            mix8_neon(v.val[0], v.val[1], vc, vs, rotation[0], rotation[1]);
+            vst2q_s16(dptr + 2 * i, v);
+        }
+        nco->advance(end - start);
+    }
+    mixToCS16_scalar(xi + i, xq + i, dptr + 2 * i, numSamples - i, nco);
+}
+
+static void mix_neon(const short *xi, const short *xq, short *outI, short *outQ, unsigned int numSamples, SoapySDRPlayNco *nco)
+{
+    unsigned int i = 0;
+    while (i + 8 <= numSamples)
+    {
+        const unsigned int start = i;
+        const unsigned int end = std::min(start + ncoBlock, numSamples & ~7u);
+        float c[4], s[4], rotation[2];
+        ncoStart(nco, 4, c, s, rotation);
+        float32x4_t vc = vld1q_f32(c);
+        float32x4_t vs = vld1q_f32(s);
+        for (; i < end; i += 8)
+        {
+            int16x8_t vi = vld1q_s16(xi + i);
+            int16x8_t vq = vld1q_s16(xq + i);
+            mix8_neon(vi, vq, vc, vs, rotation[0], rotation[1]);
+            vst1q_s16(outI + i, vi);
+            vst1q_s16(outQ + i, vq);
+        }
+        nco->advance(end - start);
+    }
+    mix_scalar(xi + i, xq + i, outI + i, outQ + i, numSamples - i, nco);
+}
+
+#endif // CONVERSION_NEON
+
+/*******************************************************************
+ * Kernel selection
+ ******************************************************************/
+
+std::vector<SoapySDRPlayConverters> SoapySDRPlay_listConverters(void)
+{
+    std::vector<SoapySDRPlayConverters> converters;
+
+    SoapySDRPlayConverters scalar = { "scalar", toCS16_scalar, toCF32_scalar, toCS12_scalar, toCS8_scalar, peak_scalar, cs16ToCF32_scalar,
+        halfBand_scalar, dot_scalar, split_scalar, fromCF32_scalar, mixToCS16_scalar, mix_scalar };
+    converters.push_back(scalar);
+
+#ifdef CONVERSION_X86
+    if (cpuSupports("sse2"))
+    {
+        SoapySDRPlayConverters sse2 = { "sse2", toCS16_sse2, toCF32_sse2, toCS12_sse2, toCS8_sse2, peak_sse2, cs16ToCF32_sse2,
+            halfBand_sse2, dot_sse2, split_sse2, fromCF32_sse2, mixToCS16_sse2, mix_sse2 };
+        converters.push_back(sse2);
+        if (cpuSupports("avx2"))
+        {
+            SoapySDRPlayConverters avx2 = { "avx2", toCS16_avx2, toCF32_avx2, toCS12_avx2, toCS8_avx2, peak_avx2, cs16ToCF32_avx2,
+                halfBand_avx2, dot_avx2, split_avx2, fromCF32_avx2, mixToCS16_avx2, mix_avx2 };
+            converters.push_back(avx2);
+        }
+    }
+#endif
+
+#ifdef CONVERSION_NEON
+    SoapySDRPlayConverters neon = { "neon", toCS16_neon, toCF32_neon, toCS12_neon, toCS8_neon, peak_neon, cs16ToCF32_neon,
+        halfBand_neon, dot_neon, split_neon, fromCF32_neon, mixToCS16_neon, mix_neon };
+    converters.push_back(neon);
+#endif
+
+    return converters;
+}
+
+const SoapySDRPlayConverters &SoapySDRPlay_getConverters(void)
+{
+    // the list is ordered from the slowest to the fastest kernels
+    static const SoapySDRPlayConverters converters = SoapySDRPlay_listConverters().back();
+    return converters;
+}
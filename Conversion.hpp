@@ -0,0 +1,115 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Charles J. Cliffe
+ * Copyright (c) 2020 Franco Venturi - changes for SDRplay API version 3
+ *                                     and Dual Tuner for RSPduo
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+// Interleave the separate I and Q arrays delivered by the SDRplay API
+// into the stream format. 'out' receives 'numSamples' complex samples.
+typedef void (*SoapySDRPlayConvertFn)(const short *xi, const short *xq, void *out, unsigned int numSamples);
+
+// CS8: the samples are shifted right by 'shift' bits (0 to 8) with
+// rounding, and saturated to 8 bits
+typedef void (*SoapySDRPlayConvertShiftFn)(const short *xi, const short *xq, void *out, unsigned int numSamples, unsigned int shift);
+
+// CS16 samples already interleaved (as stored in the stream buffers)
+// to CF32
+typedef void (*SoapySDRPlayConvertInterleavedFn)(const short *in, void *out, unsigned int numSamples);
+
+// largest magnitude of the I and Q values (up to 32768)
+typedef unsigned int (*SoapySDRPlayPeakFn)(const short *xi, const short *xq, unsigned int numSamples);
+
+// half-band decimation by 2 (see Resampler.cpp) of complex samples
+// (interleaved float), split into the even and the odd ones:
+//   out[m] = center * odd[m + numTaps - 1]
+//          + sum(taps[k] * (even[m + numTaps - 1 - k] + even[m + numTaps + k]))
+typedef void (*SoapySDRPlayHalfBandFn)(const float *even, const float *odd, const float *taps, unsigned int numTaps,
+                                       float center, float *out, unsigned int numOutputs);
+
+// dot product of numTaps real taps, each stored twice (for I and Q), with
+// numTaps complex samples (interleaved float); numTaps is a multiple of 4
+typedef void (*SoapySDRPlayDotFn)(const float *taps, const float *x, unsigned int numTaps, float *out);
+
+// complex samples (interleaved float) split into the even and the odd
+// ones, the first one being even (the input of the half-band filters)
+typedef void (*SoapySDRPlaySplitFn)(const float *in, float *even, float *odd, unsigned int numSamples);
+
+// complex samples (interleaved float, full scale 1) back to separate I
+// and Q arrays of 16 bit values, rounded and saturated
+typedef void (*SoapySDRPlayFromCF32Fn)(const float *in, short *outI, short *outQ, unsigned int numSamples);
+
+// numerically controlled oscillator of the software frequency shift:
+// the samples are multiplied by exp(2*pi*j*phase), where the phase (in
+// cycles) goes up by step every sample
+struct SoapySDRPlayNco
+{
+    double phase;
+    double step;
+
+    void advance(unsigned int numSamples)
+    {
+        phase += step * numSamples;
+        phase -= std::floor(phase);
+    }
+};
+
+// frequency shift fused with the interleaving into CS16 (rounded and
+// saturated); the oscillator moves on by numSamples
+typedef void (*SoapySDRPlayMixFn)(const short *xi, const short *xq, void *out, unsigned int numSamples, SoapySDRPlayNco *nco);
+
+// same into separate I and Q arrays, which may be xi and xq
+typedef void (*SoapySDRPlayMixSplitFn)(const short *xi, const short *xq, short *outI, short *outQ, unsigned int numSamples,
+                                       SoapySDRPlayNco *nco);
+
+struct SoapySDRPlayConverters
+{
+    const char *name;
+    SoapySDRPlayConvertFn toCS16;
+    SoapySDRPlayConvertFn toCF32;
+    // CS12: the upper 12 bits of I and Q packed in 3 bytes
+    // (same layout as the SoapySDR CS12 converters)
+    SoapySDRPlayConvertFn toCS12;
+    SoapySDRPlayConvertShiftFn toCS8;
+    SoapySDRPlayPeakFn peak;
+    SoapySDRPlayConvertInterleavedFn cs16ToCF32;
+    // software resampling filters
+    SoapySDRPlayHalfBandFn halfBand;
+    SoapySDRPlayDotFn dot;
+    SoapySDRPlaySplitFn split;
+    SoapySDRPlayFromCF32Fn fromCF32;
+    // software frequency shift
+    SoapySDRPlayMixFn mixToCS16;
+    SoapySDRPlayMixSplitFn mix;
+};
+
+// fastest set of conversion kernels supported by this CPU
+// (selected once at runtime by CPU feature detection)
+const SoapySDRPlayConverters &SoapySDRPlay_getConverters(void);
+
+// all the sets of conversion kernels supported by this CPU,
+// the scalar implementation always being the first one
+std::vector<SoapySDRPlayConverters> SoapySDRPlay_listConverters(void);
@@ -0,0 +1,310 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Charles J. Cliffe
+ * Copyright (c) 2020 Franco Venturi - changes for SDRplay API version 3
+ *                                     and Dual Tuner for RSPduo
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "Resampler.hpp"
+#include <algorithm>
+#include <cmath>
+
+static const double pi = 3.14159265358979323846;
+
+// stopband attenuation of the filters (dB), and the Kaiser window for it
+static const double attenuation = 70.0;
+static const double kaiserBeta = 0.1102 * (attenuation - 8.7);
+
+// the half-band filter has 4 * halfBandTaps - 1 taps; every other one
+// is zero, except the center one
+static const unsigned int halfBandTaps = 11;
+
+static double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50 && term > sum * 1e-12; k++)
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Kaiser window over t in [-1, 1]
+static double kaiser(double t)
+{
+    const double r = 1.0 - t * t;
+    return r > 0 ? besselI0(kaiserBeta * std::sqrt(r)) / besselI0(kaiserBeta) : 0.0;
+}
+
+static double sinc(double x)
+{
+    return x == 0 ? 1.0 : std::sin(pi * x) / (pi * x);
+}
+
+static unsigned long long gcd(unsigned long long a, unsigned long long b)
+{
+    while (b != 0)
+    {
+        unsigned long long r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+std::shared_ptr<const SoapySDRPlayResampler::Design> SoapySDRPlayResampler::design(unsigned int inputRate, unsigned int outputRate)
+{
+    std::shared_ptr<Design> design = std::make_shared<Design>();
+    design->inputRate = inputRate;
+    design->outputRate = outputRate;
+
+    // decimate by 2 as long as the output rate is still covered; each
+    // half-band filter passes 0.2 and stops from 0.3 of its input rate
+    unsigned long long rate = outputRate;
+    design->halfBands = 0;
+    while (rate * 2 <= inputRate)
+    {
+        rate *= 2;
+        design->halfBands++;
+    }
+    const unsigned int center = 2 * halfBandTaps - 1;
+    double sum = 0;
+    for (unsigned int k = 0; k < halfBandTaps; k++)
+    {
+        const double offset = 2 * k + 1;
+        const double tap = 0.5 * sinc(0.5 * offset) * kaiser(offset / (center + 1));
+        design->halfBandTaps.push_back((float)tap);
+        sum += 2 * tap;
+    }
+    for (auto &tap : design->halfBandTaps)
+    {
+        tap = (float)(tap * 0.5 / sum);
+    }
+    design->halfBandCenter = 0.5f;
+
+    // the ratio left, in lowest terms
+    const unsigned long long divisor = gcd(rate, inputRate);
+    design->interpolation = (unsigned int)(rate / divisor);
+    design->decimation = (unsigned int)(inputRate / divisor);
+    design->phases = 0;
+    design->tapsPerPhase = 0;
+    if (design->interpolation != design->decimation)
+    {
+        // cutoff at the output Nyquist frequency, transition band from 0.4
+        // to 0.6 of the output rate (in cycles per input sample)
+        const double ratio = (double)design->interpolation / design->decimation;
+        const double cutoff = 0.5 * ratio;
+        const double width = 0.2 * ratio;
+        unsigned int taps = (unsigned int)std::ceil((attenuation - 8.0) / (2.285 * 2 * pi * width)) + 1;
+        taps = (taps + 3) / 4 * 4;
+        design->phases = std::min(design->interpolation, (unsigned int)MAX_PHASES);
+        design->tapsPerPhase = taps;
+
+        // phase p is the filter sampled at p/phases of an input sample past
+        // the center of the window, in the order of the input samples, and
+        // scaled for unity gain at DC
+        design->polyphaseTaps.resize(2 * design->phases * taps);
+        for (unsigned int p = 0; p < design->phases; p++)
+        {
+            float *phase = design->polyphaseTaps.data() + 2 * p * taps;
+            const double fraction = (double)p / design->phases;
+            double phaseSum = 0;
+            std::vector<double> values(taps);
+            for (unsigned int s = 0; s < taps; s++)
+            {
+                const double t = taps / 2 - 1.0 - s + fraction;
+                values[s] = 2 * cutoff * sinc(2 * cutoff * t) * kaiser(t / (taps / 2));
+                phaseSum += values[s];
+            }
+            for (unsigned int s = 0; s < taps; s++)
+            {
+                phase[2 * s] = phase[2 * s + 1] = (float)(values[s] / phaseSum);
+            }
+        }
+    }
+    return design;
+}
+
+SoapySDRPlayResampler::SoapySDRPlayResampler(void)
+{
+    _converters = &SoapySDRPlay_getConverters();
+    _start = 0;
+    _frac = 0;
+}
+
+void SoapySDRPlayResampler::configure(const std::shared_ptr<const Design> &design)
+{
+    _design = design;
+    _stages.resize(design ? design->halfBands : 0);
+    restart();
+}
+
+void SoapySDRPlayResampler::restart(void)
+{
+    if (!_design)
+    {
+        return;
+    }
+
+    // zeros before the first sample, so that the first output sample is
+    // centered on it
+    const unsigned int numTaps = (unsigned int)_design->halfBandTaps.size();
+    for (auto &stage : _stages)
+    {
+        stage.even.reset(numTaps);
+        stage.odd.reset(numTaps - 1);
+        stage.nextOdd = true;
+    }
+    _history.reset(_design->tapsPerPhase != 0 ? _design->tapsPerPhase / 2 - 1 : 0);
+    _start = 0;
+    _frac = 0;
+}
+
+void SoapySDRPlayResampler::Window::reset(size_t numZeros)
+{
+    if (buffer.size() < 2 * numZeros)
+    {
+        buffer.resize(2 * numZeros);
+    }
+    std::fill(buffer.begin(), buffer.begin() + 2 * numZeros, 0.0f);
+    first = 0;
+    last = numZeros;
+}
+
+float *SoapySDRPlayResampler::Window::append(size_t numSamples)
+{
+    if (2 * (last + numSamples) > buffer.size())
+    {
+        std::copy(buffer.begin() + 2 * first, buffer.begin() + 2 * last, buffer.begin());
+        last -= first;
+        first = 0;
+        if (2 * (last + numSamples) > buffer.size())
+        {
+            buffer.resize(2 * (last + 2 * numSamples));
+        }
+    }
+    float *end = buffer.data() + 2 * last;
+    last += numSamples;
+    return end;
+}
+
+unsigned int SoapySDRPlayResampler::process(const short *xi, const short *xq, unsigned int numSamples)
+{
+    const Design &design = *_design;
+
+    // complex float, full scale 1
+    int w = 0;
+    if (_work[w].size() < 2 * numSamples)
+    {
+        _work[w].resize(2 * numSamples);
+    }
+    _converters->toCF32(xi, xq, _work[w].data(), numSamples);
+    const float *in = _work[w].data();
+    size_t n = numSamples;
+
+    // half-band decimators
+    const unsigned int numTaps = (unsigned int)design.halfBandTaps.size();
+    for (auto &stage : _stages)
+    {
+        // the input goes alternately to the odd and the even samples
+        Window &first = stage.nextOdd ? stage.odd : stage.even;
+        Window &second = stage.nextOdd ? stage.even : stage.odd;
+        float *firstEnd = first.append((n + 1) / 2);
+        float *secondEnd = second.append(n / 2);
+        _converters->split(in, firstEnd, secondEnd, (unsigned int)n);
+        if (n % 2 != 0)
+        {
+            stage.nextOdd = !stage.nextOdd;
+        }
+        const size_t numEven = stage.even.size();
+        const size_t numOdd = stage.odd.size();
+        size_t count = numEven > 2 * numTaps - 1 ? numEven - (2 * numTaps - 1) : 0;
+        count = std::min(count, numOdd > numTaps - 1 ? numOdd - (numTaps - 1) : 0);
+
+        w = 1 - w;
+        if (_work[w].size() < 2 * count)
+        {
+            _work[w].resize(2 * count);
+        }
+        _converters->halfBand(stage.even.data(), stage.odd.data(), design.halfBandTaps.data(), numTaps,
+                              design.halfBandCenter, _work[w].data(), (unsigned int)count);
+        stage.even.consume(count);
+        stage.odd.consume(count);
+        in = _work[w].data();
+        n = count;
+    }
+
+    // polyphase resampler: each output sample is the window of input
+    // samples around it with the phase nearest to its position
+    if (design.tapsPerPhase != 0)
+    {
+        std::copy(in, in + 2 * n, _history.append(n));
+        const size_t length = _history.size();
+        const unsigned int taps = design.tapsPerPhase;
+        const unsigned int phases = design.phases;
+        const unsigned int interpolation = design.interpolation;
+        const unsigned int decimation = design.decimation;
+
+        w = 1 - w;
+        const size_t maxCount = length * interpolation / decimation + 2;
+        if (_work[w].size() < 2 * maxCount)
+        {
+            _work[w].resize(2 * maxCount);
+        }
+        float *out = _work[w].data();
+        size_t count = 0;
+        for (;;)
+        {
+            unsigned int phase = (unsigned int)(((unsigned long long)_frac * phases + interpolation / 2) / interpolation);
+            size_t first = _start;
+            if (phase == phases)
+            {
+                phase = 0;
+                first++;
+            }
+            if (first + taps > length)
+            {
+                break;
+            }
+            _converters->dot(design.polyphaseTaps.data() + 2 * phase * taps, _history.data() + 2 * first, taps, out + 2 * count);
+            count++;
+            _frac += decimation;
+            _start += _frac / interpolation;
+            _frac %= interpolation;
+        }
+        _history.consume(std::min(_start, length));
+        _start -= std::min(_start, length);
+        in = out;
+        n = count;
+    }
+
+    // back to 16 bit
+    if (_outI.size() < n)
+    {
+        _outI.resize(n);
+        _outQ.resize(n);
+    }
+    _converters->fromCF32(in, _outI.data(), _outQ.data(), (unsigned int)n);
+    return (unsigned int)n;
+}
@@ -0,0 +1,120 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Charles J. Cliffe
+ * Copyright (c) 2020 Franco Venturi - changes for SDRplay API version 3
+ *                                     and Dual Tuner for RSPduo
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include "Conversion.hpp"
+#include <memory>
+#include <vector>
+
+// Software decimation after the decimation done by the SDRplay API, for
+// the sample rates the API does not support: a cascade of half-band
+// decimators by 2 followed by a polyphase rational resampler for the
+// ratio left (between 1/2 and 1). The filters pass 80% of the output
+// band and attenuate by about 70 dB what would alias into it; the output
+// samples are aligned with the input samples (no group delay).
+class SoapySDRPlayResampler
+{
+public:
+    // the filters for a pair of rates, shared by the channels of a stream
+    struct Design
+    {
+        unsigned int inputRate;
+        unsigned int outputRate;
+        unsigned int halfBands;           // number of decimators by 2
+        std::vector<float> halfBandTaps;  // nonzero taps from the center out
+        float halfBandCenter;
+        // polyphase resampler by interpolation/decimation (none if 1/1)
+        unsigned int interpolation;
+        unsigned int decimation;
+        unsigned int phases;              // interpolation, up to MAX_PHASES
+        unsigned int tapsPerPhase;
+        std::vector<float> polyphaseTaps; // each tap stored twice (I and Q)
+    };
+
+    // beyond that many phases the nearest phase is used
+    static const unsigned int MAX_PHASES = 1024;
+
+    // filters from inputRate down to outputRate
+    static std::shared_ptr<const Design> design(unsigned int inputRate, unsigned int outputRate);
+
+    SoapySDRPlayResampler(void);
+
+    // set up for a design (none: no resampling) and start over
+    void configure(const std::shared_ptr<const Design> &design);
+
+    // clear the filter history, e.g. after a gap in the input
+    void restart(void);
+
+    // resamples numSamples samples; the output samples are in outI()/outQ()
+    // until the next call
+    unsigned int process(const short *xi, const short *xq, unsigned int numSamples);
+
+    short *outI(void) { return _outI.data(); }
+    short *outQ(void) { return _outQ.data(); }
+
+private:
+    // complex samples (interleaved float) kept from one call to the next:
+    // the new ones go after the ones not used yet, which only move back
+    // to the beginning when the end of the buffer is reached; the buffer
+    // holds the filter history plus twice the longest input so far, so
+    // it is only allocated again when the input gets longer
+    struct Window
+    {
+        std::vector<float> buffer;
+        size_t first;
+        size_t last;
+
+        // numZeros zeros only
+        void reset(size_t numZeros);
+        // room for numSamples more samples
+        float *append(size_t numSamples);
+        void consume(size_t numSamples) { first += numSamples; }
+        const float *data(void) const { return buffer.data() + 2 * first; }
+        size_t size(void) const { return last - first; }
+    };
+
+    struct HalfBandStage
+    {
+        // input samples not used yet, split into the even and the odd ones
+        Window even;
+        Window odd;
+        bool nextOdd;
+    };
+
+    std::shared_ptr<const Design> _design;
+    const SoapySDRPlayConverters *_converters;
+    std::vector<HalfBandStage> _stages;
+
+    // polyphase resampler input, the window start of the next output
+    // sample, and its phase in 1/interpolation of an input sample
+    Window _history;
+    size_t _start;
+    unsigned int _frac;
+
+    std::vector<float> _work[2];
+    std::vector<short> _outI;
+    std::vector<short> _outQ;
+};
@@ -25,6 +25,9 @@
  */
 
 #include "SoapySDRPlay.hpp"
+#include <sstream>
+#include <cmath>
+#include <climits>
 
 #if defined(_M_X64) || defined(_M_IX86)
 #define strcasecmp _stricmp
@@ -64,6 +67,41 @@ SoapySDRPlay::SoapySDRPlay(const SoapySDR::Kwargs &args)
     // change the default AGC set point to -30dBfs
     chParams->ctrlParams.agc.setPoint_dBfs = -30;
 
+    // streaming settings (before the device args, which writeSetting()
+    // may check them against)
+    _streams[0] = 0;
+    _streams[1] = 0;
+    _streamsRefCount[0] = 0;
+    _streamsRefCount[1] = 0;
+    callbacksInFlight[0] = 0;
+    callbacksInFlight[1] = 0;
+    callbackEpoch = 0;
+    callbacksWaiting = false;
+    converters = &SoapySDRPlay_getConverters();
+    outputSampleRate = 0;
+    resamplerGeneration = 0;
+    basebandFrequency = 0;
+    hardwareTimeNs = 0;
+    timeOffsetNs = 0;
+    gr_changed = 0;
+    rf_changed = 0;
+    fs_changed = 0;
+    sweepStream = nullptr;
+    sweepRunning = false;
+    teardownState = TEARDOWN_NONE;
+    teardownCancel = false;
+
+    streamActive = false;
+
+    device_unavailable = false;
+
+    standby = false;
+    commandTimeNs = 0;
+    nextCommandTimeNs = LLONG_MAX;
+    commandDueNs = LLONG_MIN;
+    commandGeneration = 0;
+    commandRunning = false;
+
     // process additional device string arguments
     for (std::pair<std::string, std::string> arg : args) {
         // ignore 'driver', 'label', 'mode', 'serial', and 'soapy'
@@ -75,21 +113,6 @@ SoapySDRPlay::SoapySDRPlay(const SoapySDR::Kwargs &args)
         writeSetting(arg.first, arg.second);
     }
 
-    // streaming settings
-    // this may change later according to format
-    shortsPerWord = 1;
-    bufferLength = bufferElems * elementsPerSample * shortsPerWord;
-
-    _streams[0] = 0;
-    _streams[1] = 0;
-    _streamsRefCount[0] = 0;
-    _streamsRefCount[1] = 0;
-    useShort = true;
-
-    streamActive = false;
-
-    device_unavailable = false;
-
     cacheKey = serNo;
     if (hwVer == SDRPLAY_RSPduo_ID) cacheKey += "@" + args.at("mode");
     SoapySDRPlay_getClaimedSerials().insert(cacheKey);
@@ -98,8 +121,17 @@ SoapySDRPlay::SoapySDRPlay(const SoapySDR::Kwargs &args)
 SoapySDRPlay::~SoapySDRPlay(void)
 {
     SoapySDRPlay_getClaimedSerials().erase(cacheKey);
+    stopSweep();
+    stopCommands();
+    cancelTeardown();
     std::lock_guard <std::mutex> lock(_general_state_mutex);
 
+    // the tuner may still be streaming in standby, or waiting for the
+    // RSPduo slave to stop
+    if (streamActive)
+    {
+        stopStreaming();
+    }
     releaseDevice();
 
     _streams[0] = 0;
@@ -108,6 +140,15 @@ SoapySDRPlay::~SoapySDRPlay(void)
     _streamsRefCount[1] = 0;
 }
 
+// wait until rx_callback reports that the hardware applied an update;
+// the flag must be cleared before calling sdrplay_api_Update()
+bool SoapySDRPlay::waitForChanged(const std::atomic_int &changed)
+{
+    std::unique_lock <std::mutex> lock(update_mutex);
+    return update_cond.wait_for(lock, std::chrono::milliseconds(updateTimeout),
+                                [&changed]{ return changed != 0; });
+}
+
 /*******************************************************************
  * Identification API
  ******************************************************************/
@@ -138,10 +179,21 @@ SoapySDR::Kwargs SoapySDRPlay::getHardwareInfo(void) const
     float ver = SoapySDRPlay::sdrplay_api::get_version();
     hwArgs["sdrplay_api_api_version"] = std::to_string(ver);
     hwArgs["sdrplay_api_hw_version"] = std::to_string(device.hwVer);
+    hwArgs["adc_bits"] = std::to_string(getAdcBits());
 
     return hwArgs;
 }
 
+unsigned int SoapySDRPlay::getAdcBits(void) const
+{
+    // RSP1 and RSP2 have a 12 bit ADC, the later models a 14 bit one
+    if (device.hwVer == SDRPLAY_RSP1_ID || device.hwVer == SDRPLAY_RSP2_ID)
+    {
+        return 12;
+    }
+    return 14;
+}
+
 /*******************************************************************
  * Channels API
  ******************************************************************/
@@ -536,8 +588,20 @@ bool SoapySDRPlay::getGainMode(const int direction, const size_t channel) const
 
 void SoapySDRPlay::setGain(const int direction, const size_t channel, const std::string &name, const double value)
 {
+    if (scheduleCommand(commandTimeNs, TimedCommand::GAIN, name, value))
+    {
+        return;
+    }
+
     std::lock_guard <std::mutex> lock(_general_state_mutex);
 
+    applyGain(name, value);
+}
+
+// sets a named gain (with _general_state_mutex held); rx_callback
+// cannot wait for the update to be reported, since it reports it
+void SoapySDRPlay::applyGain(const std::string &name, const double value, const bool wait)
+{
    bool doUpdate = false;
 
    if (name == "IFGR")
@@ -572,14 +636,7 @@ void SoapySDRPlay::setGain(const int direction, const size_t channel, const std:
          SoapySDR_logf(SOAPY_SDR_WARNING, "sdrplay_api_Update(Tuner_Gr) Error: %s", sdrplay_api_GetErrorString(err));
          return;
       }
-      for (int i = 0; i < updateTimeout; ++i)
-      {
-         if (gr_changed != 0) {
-            break;
-         }
-         std::this_thread::sleep_for(std::chrono::milliseconds(1));
-      }
-      if (gr_changed == 0)
+      if (wait && !waitForChanged(gr_changed))
       {
          SoapySDR_log(SOAPY_SDR_WARNING, "Gain reduction update timeout.");
       }
@@ -648,8 +705,32 @@ void SoapySDRPlay::setFrequency(const int direction,
                                  const double frequency,
                                  const SoapySDR::Kwargs &args)
 {
-    // default to RF
-    setFrequency(direction, channel, "RF", frequency, args);
+    // RF=IGNORE leaves the tuner where it is and gets to the frequency
+    // with the software shift only
+    auto rf = args.find("RF");
+    if (rf != args.end() && rf->second == "IGNORE")
+    {
+        setFrequency(direction, channel, "BB", frequency - getFrequency(direction, channel, "RF"), args);
+        return;
+    }
+
+    // otherwise the tuner goes to the frequency plus OFFSET (if any), and
+    // the software shift takes the offset back
+    double offset = 0;
+    auto offsetArg = args.find("OFFSET");
+    if (offsetArg != args.end())
+    {
+        offset = std::stod(offsetArg->second);
+    }
+    setFrequency(direction, channel, "RF", frequency + offset, args);
+    // no shift to take back, and none to clear: nothing to do for BB
+    // (unless timed, as a shift may still be queued before it)
+    const bool timed = commandTimeNs != 0 || args.count("TIME") != 0;
+    if (offset == 0 && basebandFrequency == 0 && !timed)
+    {
+        return;
+    }
+    setFrequency(direction, channel, "BB", offset != 0 ? -offset : 0, args);
 }
 
 void SoapySDRPlay::setFrequency(const int direction,
@@ -658,62 +739,64 @@ void SoapySDRPlay::setFrequency(const int direction,
                                  const double frequency,
                                  const SoapySDR::Kwargs &args)
 {
+   if (direction != SOAPY_SDR_RX)
+   {
+      return;
+   }
+
+   // TIME overrides the command time for this change only
+   long long timeNs = commandTimeNs;
+   auto timeArg = args.find("TIME");
+   if (timeArg != args.end())
+   {
+      timeNs = std::stoll(timeArg->second);
+   }
+   if (scheduleCommand(timeNs, TimedCommand::FREQUENCY, name, frequency))
+   {
+      return;
+   }
+
    std::lock_guard <std::mutex> lock(_general_state_mutex);
 
+   applyFrequency(name, frequency);
+}
 
-   if (direction == SOAPY_SDR_RX)
+// sets a named frequency (with _general_state_mutex held)
+void SoapySDRPlay::applyFrequency(const std::string &name, const double frequency, const bool wait)
+{
+   if (name == "RF")
    {
-      if (name == "RF")
+      setRfFrequency(frequency, wait);
+   }
+   else if (name == "BB")
+   {
+      // a shift within the usable bandwidth is done in software, from
+      // the next callback on and without a glitch; anything larger
+      // moves the tuner by that much instead
+      if (std::fabs(frequency) <= getBasebandFrequencyLimit())
       {
-         SoapySDR::RangeList frequencyRange = getFrequencyRange(direction, channel, name);
-         if (!(frequency >= frequencyRange.front().minimum() && frequency <= frequencyRange.back().maximum()))
-         {
-            SoapySDR_logf(SOAPY_SDR_WARNING, "RF center frequency out of range - frequency=%lg", frequency);
-            return;
-         }
-         if (chParams->tunerParams.rfFreq.rfHz != (uint32_t)frequency)
-         {
-            chParams->tunerParams.rfFreq.rfHz = (uint32_t)frequency;
-            if (streamActive)
-            {
-               rf_changed = 0;
-               sdrplay_api_ErrT err = sdrplay_api_Update(device.dev, device.tuner, sdrplay_api_Update_Tuner_Frf, sdrplay_api_Update_Ext1_None);
-               if (err != sdrplay_api_Success)
-               {
-                  SoapySDR_logf(SOAPY_SDR_WARNING, "sdrplay_api_Update(Tuner_FrF) Error: %s", sdrplay_api_GetErrorString(err));
-                  return;
-               }
-               for (int i = 0; i < updateTimeout; ++i)
-               {
-                  if (rf_changed != 0) {
-                     break;
-                  }
-                  std::this_thread::sleep_for(std::chrono::milliseconds(1));
-               }
-               if (rf_changed == 0)
-               {
-                  SoapySDR_log(SOAPY_SDR_WARNING, "RF center frequency update timeout.");
-               }
-            }
-         }
+         basebandFrequency = frequency;
       }
-      // can't set ppm for RSPduo slaves
-      else if ((name == "CORR") && deviceParams->devParams &&
-              (deviceParams->devParams->ppm != frequency))
+      else if (setRfFrequency(chParams->tunerParams.rfFreq.rfHz + frequency, wait))
       {
-         deviceParams->devParams->ppm = frequency;
-         if (streamActive)
-         {
-            sdrplay_api_Update(device.dev, device.tuner, sdrplay_api_Update_Dev_Ppm, sdrplay_api_Update_Ext1_None);
-         }
+         basebandFrequency = 0;
+      }
+   }
+   // can't set ppm for RSPduo slaves
+   else if ((name == "CORR") && deviceParams->devParams &&
+           (deviceParams->devParams->ppm != frequency))
+   {
+      deviceParams->devParams->ppm = frequency;
+      if (streamActive)
+      {
+         sdrplay_api_Update(device.dev, device.tuner, sdrplay_api_Update_Dev_Ppm, sdrplay_api_Update_Ext1_None);
       }
    }
 }
 
 double SoapySDRPlay::getFrequency(const int direction, const size_t channel) const
 {
-    // default to RF
-    return getFrequency(direction, channel, "RF");
+    return getFrequency(direction, channel, "RF") + getFrequency(direction, channel, "BB");
 }
 
 double SoapySDRPlay::getFrequency(const int direction, const size_t channel, const std::string &name) const
@@ -724,6 +807,10 @@ double SoapySDRPlay::getFrequency(const int direction, const size_t channel, con
     {
         return (double)chParams->tunerParams.rfFreq.rfHz;
     }
+    else if (name == "BB")
+    {
+        return basebandFrequency;
+    }
     else if (name == "CORR")
     {
         if (deviceParams->devParams)
@@ -741,6 +828,7 @@ std::vector<std::string> SoapySDRPlay::listFrequencies(const int direction, cons
 {
     std::vector<std::string> names;
     names.push_back("RF");
+    names.push_back("BB");
     names.push_back("CORR");
     return names;
 }
@@ -764,6 +852,11 @@ SoapySDR::RangeList SoapySDRPlay::getFrequencyRange(const int direction, const s
             results.push_back(SoapySDR::Range(1000, 2000000000));
         }
     }
+    else if (name == "BB")
+    {
+        const double limit = getBasebandFrequencyLimit();
+        results.push_back(SoapySDR::Range(-limit, limit));
+    }
     return results;
 }
 
@@ -771,9 +864,77 @@ SoapySDR::ArgInfoList SoapySDRPlay::getFrequencyArgsInfo(const int direction, co
 {
     SoapySDR::ArgInfoList freqArgs;
 
+    SoapySDR::ArgInfo OffsetArg;
+    OffsetArg.key = "OFFSET";
+    OffsetArg.value = "0";
+    OffsetArg.name = "Offset";
+    OffsetArg.description = "Tune the RF frequency this far off and shift the samples back in software";
+    OffsetArg.units = "Hz";
+    OffsetArg.type = SoapySDR::ArgInfo::FLOAT;
+    freqArgs.push_back(OffsetArg);
+
+    SoapySDR::ArgInfo RfArg;
+    RfArg.key = "RF";
+    RfArg.value = "DEFAULT";
+    RfArg.name = "RF";
+    RfArg.description = "IGNORE to keep the RF frequency and tune with the software shift only";
+    RfArg.type = SoapySDR::ArgInfo::STRING;
+    RfArg.options.push_back("DEFAULT");
+    RfArg.options.push_back("IGNORE");
+    freqArgs.push_back(RfArg);
+
+    SoapySDR::ArgInfo TimeArg;
+    TimeArg.key = "TIME";
+    TimeArg.value = "0";
+    TimeArg.name = "Time";
+    TimeArg.description = "Stream time to make the change at (0 for now or the command time)";
+    TimeArg.units = "ns";
+    TimeArg.type = SoapySDR::ArgInfo::INT;
+    freqArgs.push_back(TimeArg);
+
     return freqArgs;
 }
 
+// sets the tuner frequency (with _general_state_mutex held); false if
+// it is out of range or the update failed; without wait it does not
+// wait for rx_callback to report the update
+bool SoapySDRPlay::setRfFrequency(double frequency, const bool wait)
+{
+   SoapySDR::RangeList frequencyRange = getFrequencyRange(SOAPY_SDR_RX, 0, "RF");
+   if (!(frequency >= frequencyRange.front().minimum() && frequency <= frequencyRange.back().maximum()))
+   {
+      SoapySDR_logf(SOAPY_SDR_WARNING, "RF center frequency out of range - frequency=%lg", frequency);
+      return false;
+   }
+   if (chParams->tunerParams.rfFreq.rfHz != (uint32_t)frequency)
+   {
+      chParams->tunerParams.rfFreq.rfHz = (uint32_t)frequency;
+      if (streamActive)
+      {
+         rf_changed = 0;
+         sdrplay_api_ErrT err = sdrplay_api_Update(device.dev, device.tuner, sdrplay_api_Update_Tuner_Frf, sdrplay_api_Update_Ext1_None);
+         if (err != sdrplay_api_Success)
+         {
+            SoapySDR_logf(SOAPY_SDR_WARNING, "sdrplay_api_Update(Tuner_FrF) Error: %s", sdrplay_api_GetErrorString(err));
+            return false;
+         }
+         if (wait && !waitForChanged(rf_changed))
+         {
+            SoapySDR_log(SOAPY_SDR_WARNING, "RF center frequency update timeout.");
+         }
+      }
+   }
+   return true;
+}
+
+// largest software frequency shift: the signal has to stay within both
+// the IF filter bandwidth and the sample rate
+double SoapySDRPlay::getBasebandFrequencyLimit(void) const
+{
+   const double bandwidth = std::min(getBwValueFromEnum(chParams->tunerParams.bwType), getSampleRate(SOAPY_SDR_RX, 0));
+   return bandwidth / 2;
+}
+
 /*******************************************************************
  * Sample Rate API
  ******************************************************************/
@@ -795,6 +956,28 @@ void SoapySDRPlay::setSampleRate(const int direction, const size_t channel, cons
        unsigned int decEnable;
        sdrplay_api_If_kHzT ifType;
        double input_sample_rate = getInputSampleRateAndDecimation(output_sample_rate, &decM, &decEnable, &ifType);
+
+       // rates the API does not support are resampled in software from
+       // the lowest rate it supports above them
+       std::shared_ptr<const SoapySDRPlayResampler::Design> design;
+       if (input_sample_rate < 0)
+       {
+           uint32_t resampled_rate = (uint32_t)std::lround(output_sample_rate);
+           uint32_t api_sample_rate = getResampledInputRate(resampled_rate);
+           if (api_sample_rate != 0)
+           {
+               input_sample_rate = getInputSampleRateAndDecimation(api_sample_rate, &decM, &decEnable, &ifType);
+               if (resamplerDesign && resamplerDesign->inputRate == api_sample_rate && resamplerDesign->outputRate == resampled_rate)
+               {
+                   design = resamplerDesign;
+               }
+               else
+               {
+                   design = SoapySDRPlayResampler::design(api_sample_rate, resampled_rate);
+               }
+               SoapySDR_logf(SOAPY_SDR_DEBUG, "Resampling from %u to %u in software", api_sample_rate, resampled_rate);
+           }
+       }
        if (input_sample_rate < 0) {
            SoapySDR_logf(SOAPY_SDR_WARNING, "invalid sample rate. Sample rate unchanged.");
            return;
@@ -832,11 +1015,23 @@ void SoapySDRPlay::setSampleRate(const int direction, const size_t channel, cons
           chParams->tunerParams.bwType = bwType;
           reasonForUpdate = (sdrplay_api_ReasonForUpdateT)(reasonForUpdate | sdrplay_api_Update_Tuner_BwType);
        }
-       if (reasonForUpdate != sdrplay_api_Update_None)
+       // a new software resampling takes effect with the next callback
+       const bool resamplerChanged = design != resamplerDesign;
+       if (resamplerChanged)
        {
-          if (_streams[0]) { _streams[0]->reset = true; }
-          if (_streams[1]) { _streams[1]->reset = true; }
-          if (streamActive)
+          std::lock_guard <std::mutex> resamplerLock(resampler_mutex);
+          resamplerDesign = design;
+          resamplerGeneration++;
+       }
+       if (reasonForUpdate != sdrplay_api_Update_None || resamplerChanged)
+       {
+          for (int i = 0; i < 2; ++i)
+          {
+             SoapySDRPlayStream *stream = _streams[i];
+             if (stream) { stream->reset = true; }
+          }
+          outputSampleRate = design ? design->outputRate : output_sample_rate;
+          if (streamActive && reasonForUpdate != sdrplay_api_Update_None)
           {
              // beware that when the fs change crosses the boundary between
              // 2,685,312 and 2,685,313 the rx_callbacks stop for some
@@ -850,14 +1045,7 @@ void SoapySDRPlay::setSampleRate(const int direction, const size_t channel, cons
              }
              if (waitForUpdate)
              {
-                for (int i = 0; i < updateTimeout; ++i)
-                {
-                   if (fs_changed != 0) {
-                      break;
-                   }
-                   std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                }
-                if (fs_changed == 0)
+                if (!waitForChanged(fs_changed))
                 {
                    SoapySDR_log(SOAPY_SDR_WARNING, "Sample rate update timeout.");
                 }
@@ -884,6 +1072,14 @@ double SoapySDRPlay::getSampleRate(const int direction, const size_t channel) co
       throw std::runtime_error("Invalid sample rate and/or IF setting");
    }
 
+   {
+      std::lock_guard <std::mutex> lock(resampler_mutex);
+      if (resamplerDesign)
+      {
+         return resamplerDesign->outputRate;
+      }
+   }
+
    if (!chParams->ctrlParams.decimation.enable)
    {
       return fsHz;
@@ -898,6 +1094,12 @@ std::vector<double> SoapySDRPlay::listSampleRates(const int direction, const siz
 {
     std::vector<double> output_sample_rates;
 
+    // a few narrowband rates resampled in software
+    output_sample_rates.push_back(8000);
+    output_sample_rates.push_back(16000);
+    output_sample_rates.push_back(24000);
+    output_sample_rates.push_back(48000);
+
     if (device.hwVer == SDRPLAY_RSPduo_ID && device.rspDuoMode != sdrplay_api_RspDuoMode_Single_Tuner)
     {
         output_sample_rates.push_back(62500);
@@ -935,27 +1137,15 @@ SoapySDR::RangeList SoapySDRPlay::getSampleRateRange(const int direction, const
 {
     SoapySDR::RangeList output_sample_rates;
 
+    // any rate up to 2 MHz that the API does not support is resampled
+    // in software (see getResampledInputRate())
     if (device.hwVer == SDRPLAY_RSPduo_ID && device.rspDuoMode != sdrplay_api_RspDuoMode_Single_Tuner)
     {
-        output_sample_rates.push_back(SoapySDR::Range(62500, 62500));
-        output_sample_rates.push_back(SoapySDR::Range(125000, 125000));
-        output_sample_rates.push_back(SoapySDR::Range(250000, 250000));
-        output_sample_rates.push_back(SoapySDR::Range(500000, 500000));
-        output_sample_rates.push_back(SoapySDR::Range(1000000, 1000000));
-        output_sample_rates.push_back(SoapySDR::Range(2000000, 2000000));
+        output_sample_rates.push_back(SoapySDR::Range(MIN_RESAMPLED_SAMPLE_RATE, 2000000));
         return output_sample_rates;
     }
 
-    output_sample_rates.push_back(SoapySDR::Range(62500, 62500));
-    output_sample_rates.push_back(SoapySDR::Range(96000, 96000));
-    output_sample_rates.push_back(SoapySDR::Range(125000, 125000));
-    output_sample_rates.push_back(SoapySDR::Range(192000, 192000));
-    output_sample_rates.push_back(SoapySDR::Range(250000, 250000));
-    output_sample_rates.push_back(SoapySDR::Range(384000, 384000));
-    output_sample_rates.push_back(SoapySDR::Range(500000, 500000));
-    output_sample_rates.push_back(SoapySDR::Range(768000, 768000));
-    output_sample_rates.push_back(SoapySDR::Range(1000000, 1000000));
-    output_sample_rates.push_back(SoapySDR::Range(2000000, 10660000));
+    output_sample_rates.push_back(SoapySDR::Range(MIN_RESAMPLED_SAMPLE_RATE, 10660000));
     return output_sample_rates;
 }
 
@@ -1022,6 +1212,32 @@ double SoapySDRPlay::getInputSampleRateAndDecimation(uint32_t output_sample_rate
     return output_sample_rate;
 }
 
+uint32_t SoapySDRPlay::getResampledInputRate(uint32_t output_sample_rate) const
+{
+    // the rates below 2 MHz the API supports (see above), in increasing
+    // order; the lowest one that covers the output rate keeps the load on
+    // USB and in the API to a minimum
+    static const uint32_t api_sample_rates[] = { 62500, 96000, 125000, 192000, 250000,
+                                                 384000, 500000, 768000, 1000000, 2000000 };
+
+    if (output_sample_rate < MIN_RESAMPLED_SAMPLE_RATE)
+    {
+        return 0;
+    }
+    for (uint32_t api_sample_rate : api_sample_rates)
+    {
+        unsigned int decM;
+        unsigned int decEnable;
+        sdrplay_api_If_kHzT ifType;
+        if (api_sample_rate >= output_sample_rate &&
+            getInputSampleRateAndDecimation(api_sample_rate, &decM, &decEnable, &ifType) >= 0)
+        {
+            return api_sample_rate;
+        }
+    }
+    return 0;
+}
+
 /*******************************************************************
 * Bandwidth API
 ******************************************************************/
@@ -1579,11 +1795,42 @@ SoapySDR::ArgInfoList SoapySDRPlay::getSettingInfo(void) const
        setArgs.push_back(HDRArg);
     }
 
+    SoapySDR::ArgInfo StandbyArg;
+    StandbyArg.key = "standby";
+    StandbyArg.value = "false";
+    StandbyArg.name = "Standby";
+    StandbyArg.description = "Keep the tuner streaming after closeStream() so that activateStream() starts right away";
+    StandbyArg.type = SoapySDR::ArgInfo::BOOL;
+    setArgs.push_back(StandbyArg);
+
+    SoapySDR::ArgInfo StreamStatsArg;
+    StreamStatsArg.key = "stream_stats";
+    StreamStatsArg.value = "";
+    StreamStatsArg.name = "Stream Statistics";
+    StreamStatsArg.description = "Read only: streaming telemetry of the open streams as JSON (callbacks, samples received, delivered and dropped, overflows, resets, USB gaps, queue depth and callback time)";
+    StreamStatsArg.type = SoapySDR::ArgInfo::STRING;
+    setArgs.push_back(StreamStatsArg);
+
+    SoapySDR::ArgInfo StreamStatsResetArg;
+    StreamStatsResetArg.key = "stream_stats_reset";
+    StreamStatsResetArg.value = "";
+    StreamStatsResetArg.name = "Reset Stream Statistics";
+    StreamStatsResetArg.description = "Write only: restart the stream_stats counters (any value)";
+    StreamStatsResetArg.type = SoapySDR::ArgInfo::STRING;
+    setArgs.push_back(StreamStatsResetArg);
+
     return setArgs;
 }
 
 void SoapySDRPlay::writeSetting(const std::string &key, const std::string &value)
 {
+   // only frequency and gain changes can be timed
+   if (commandTimeNs != 0)
+   {
+      SoapySDR_logf(SOAPY_SDR_ERROR, "writeSetting(%s) cannot be timed - setCommandTime(0) first", key.c_str());
+      return;
+   }
+
    std::lock_guard <std::mutex> lock(_general_state_mutex);
 
 #ifdef RF_GAIN_IN_MENU
@@ -1599,14 +1846,7 @@ void SoapySDRPlay::writeSetting(const std::string &key, const std::string &value
             SoapySDR_logf(SOAPY_SDR_WARNING, "sdrplay_api_Update(Tuner_Gr) Error: %s", sdrplay_api_GetErrorString(err));
             return;
          }
-         for (int i = 0; i < updateTimeout; ++i)
-         {
-            if (gr_changed != 0) {
-               break;
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-         }
-         if (gr_changed == 0)
+         if (!waitForChanged(gr_changed))
          {
             SoapySDR_log(SOAPY_SDR_WARNING, "Gain reduction update timeout.");
          }
@@ -1823,6 +2063,37 @@ void SoapySDRPlay::writeSetting(const std::string &key, const std::string &value
          }
       }
    }
+   else if (key == "standby")
+   {
+      standby = value == "true";
+      // leaving standby with no stream open: stop the tuner now
+      if (!standby && streamActive && _streamsRefCount[0] == 0 && _streamsRefCount[1] == 0)
+      {
+         startTeardown();
+      }
+   }
+   else if (key == "stream_stats_reset")
+   {
+      // restart the stream_stats counters (any value)
+      for (int i = 0; i < 2; i++)
+      {
+         SoapySDRPlayStream *stream = _streams[i];
+         if (stream == 0 || (i == 1 && stream == _streams[0])) continue;
+         const SoapySDRPlayStream::Stats &stats = stream->stats;
+         SoapySDRPlayStream::StatsBase &base = stream->statsBase;
+         base.callbacks = stats.callbacks.load(std::memory_order_relaxed);
+         base.samplesReceived = stats.samplesReceived.load(std::memory_order_relaxed);
+         base.callbackNs = stats.callbackNs.load(std::memory_order_relaxed);
+         base.samplesDelivered = stats.samplesDelivered.load(std::memory_order_relaxed);
+         base.samplesDropped = stats.samplesDropped.load(std::memory_order_relaxed) +
+                               stats.samplesFlushed.load(std::memory_order_relaxed);
+         base.overflows = stats.overflows.load(std::memory_order_relaxed);
+         base.resets = stats.resets.load(std::memory_order_relaxed);
+         base.usbGaps = stats.usbGaps.load(std::memory_order_relaxed);
+         base.usbLostSamples = stats.usbLostSamples.load(std::memory_order_relaxed);
+         stream->statsResetPending = true;
+      }
+   }
 }
 
 std::string SoapySDRPlay::readSetting(const std::string &key) const
@@ -1901,6 +2172,70 @@ std::string SoapySDRPlay::readSetting(const std::string &key) const
        if (dabNotchEn == 0) return "false";
        else                 return "true";
     }
+    else if (key == "buffer_frequency")
+    {
+       // RF frequency of the samples last returned by readStream()
+       // or acquireReadBuffer()
+       SoapySDRPlayStream *stream = _streams[0] != 0 ? _streams[0] : _streams[1];
+       if (stream == 0) return "";
+       return std::to_string(stream->readFrequency.load());
+    }
+    else if (key == "standby")
+    {
+       return standby ? "true" : "false";
+    }
+    else if (key == "teardown")
+    {
+       // how the Uninit() after the last closeStream() went
+       switch (teardownState)
+       {
+       case TEARDOWN_PENDING:   return "pending";
+       case TEARDOWN_DONE:      return "done";
+       case TEARDOWN_CANCELLED: return "cancelled";
+       case TEARDOWN_FAILED:    return "failed";
+       default:                 return "none";
+       }
+    }
+    else if (key == "stream_stats")
+    {
+       // streaming telemetry since the stream was set up, or since
+       // the last writeSetting("stream_stats_reset")
+       std::ostringstream json;
+       json << "{\"streams\":[";
+       const char *separator = "";
+       for (int i = 0; i < 2; i++)
+       {
+          const SoapySDRPlayStream *stream = _streams[i];
+          if (stream == 0 || (i == 1 && stream == _streams[0])) continue;
+          const SoapySDRPlayStream::Stats &stats = stream->stats;
+          const SoapySDRPlayStream::StatsBase &base = stream->statsBase;
+          // the minimum and maximum values are cleared by the next callback
+          const bool resetPending = stream->statsResetPending;
+          const unsigned long long callbacks = stats.callbacks.load(std::memory_order_relaxed) - base.callbacks;
+          const unsigned long long callbackNs = stats.callbackNs.load(std::memory_order_relaxed) - base.callbackNs;
+          json << separator << "{\"channel\":" << stream->channel
+               << ",\"channels\":" << stream->numChannels
+               << ",\"callbacks\":" << callbacks
+               << ",\"samples_received\":" << stats.samplesReceived.load(std::memory_order_relaxed) - base.samplesReceived
+               << ",\"samples_delivered\":" << stats.samplesDelivered.load(std::memory_order_relaxed) - base.samplesDelivered
+               << ",\"overflows\":" << stats.overflows.load(std::memory_order_relaxed) - base.overflows
+               << ",\"samples_dropped\":" << stats.samplesDropped.load(std::memory_order_relaxed) +
+                                               stats.samplesFlushed.load(std::memory_order_relaxed) - base.samplesDropped
+               << ",\"resets\":" << stats.resets.load(std::memory_order_relaxed) - base.resets
+               << ",\"usb_gaps\":" << stats.usbGaps.load(std::memory_order_relaxed) - base.usbGaps
+               << ",\"usb_samples_lost\":" << stats.usbLostSamples.load(std::memory_order_relaxed) - base.usbLostSamples
+               << ",\"queue_depth_max\":" << (resetPending ? 0 : stats.queueDepthMax.load(std::memory_order_relaxed))
+               << ",\"queue_size\":" << stream->buffs.size()
+               << ",\"callback_us\":{"
+               << "\"min\":" << (resetPending ? 0 : stats.callbackNsMin.load(std::memory_order_relaxed)) / 1e3
+               << ",\"avg\":" << (callbacks != 0 ? callbackNs / 1e3 / callbacks : 0)
+               << ",\"max\":" << (resetPending ? 0 : stats.callbackNsMax.load(std::memory_order_relaxed)) / 1e3
+               << "}}";
+          separator = ",";
+       }
+       json << "]}";
+       return json.str();
+    }
     else if (key == "hdr_ctrl")
     {
        unsigned char hdrEn = 0;
@@ -41,10 +41,31 @@
 
 #include <sdrplay_api.h>
 
+#include "Conversion.hpp"
+#include "Resampler.hpp"
+
 #define DEFAULT_BUFFER_LENGTH     (65536)
 #define DEFAULT_NUM_BUFFERS       (8)
 #define DEFAULT_ELEMS_PER_SAMPLE  (2)
 
+// lowest sample rate of the software resampling (see Resampler.hpp)
+#define MIN_RESAMPLED_SAMPLE_RATE (1000)
+
+// readStream()/acquireReadBuffer() flag: samples were lost right before
+// this buffer on their way to the host (USB or SDRplay API), as opposed
+// to the SOAPY_SDR_OVERFLOW reported when the stream queue is full
+#ifdef SOAPY_SDR_USER_FLAG0
+#define SDRPLAY_USB_LOSS_FLAG     SOAPY_SDR_USER_FLAG0
+#else
+#define SDRPLAY_USB_LOSS_FLAG     (1 << 16)
+#endif
+
+// readStream()/acquireReadBuffer() flags in CS8: the 16 bit value of a
+// sample is its CS8 value shifted left by SDRPLAY_CS8_EXPONENT(flags)
+// (fixed with the 'cs8shift' stream arg, or per buffer with cs8shift=auto)
+#define SDRPLAY_CS8_EXPONENT_SHIFT  (17)
+#define SDRPLAY_CS8_EXPONENT(flags) (((flags) >> SDRPLAY_CS8_EXPONENT_SHIFT) & 0xf)
+
 std::set<std::string> &SoapySDRPlay_getClaimedSerials(void);
 
 class SoapySDRPlay: public SoapySDR::Device
@@ -103,10 +124,30 @@ public:
                    long long &timeNs,
                    const long timeoutUs = 200000);
 
+    /*******************************************************************
+     * Time API
+     ******************************************************************/
+
+    bool hasHardwareTime(const std::string &what = "") const;
+
+    long long getHardwareTime(const std::string &what = "") const;
+
+    void setHardwareTime(const long long timeNs, const std::string &what = "");
+
+    void setCommandTime(const long long timeNs, const std::string &what = "");
+
     /*******************************************************************
      * Direct buffer access API
      ******************************************************************/
 
+    // The buffers returned by acquireReadBuffer() are the stream buffers
+    // rx_callback converts the samples into, without further copies.
+    // A buffer stays valid and is not written to until it is released
+    // with releaseReadBuffer(), even across overflows, resets and sample
+    // rate changes; buffers must be released in the order they were
+    // acquired. Their addresses do not change until closeStream().
+    // CF32 streams set up with directaccess=false do not support this API.
+
     size_t getNumDirectAccessBuffers(SoapySDR::Stream *stream);
 
     int getDirectAccessBufferAddrs(SoapySDR::Stream *stream, const size_t handle, void **buffs);
@@ -235,10 +276,16 @@ public:
      ******************************************************************/
 
     class SoapySDRPlayStream;
-    void rx_callback(short *xi, short *xq, sdrplay_api_StreamCbParamsT *params, unsigned int numSamples, SoapySDRPlayStream *stream);
+    void rx_callback(short *xi, short *xq, sdrplay_api_StreamCbParamsT *params, unsigned int numSamples, unsigned int reset, SoapySDRPlayStream *stream, size_t tuner);
 
     void ev_callback(sdrplay_api_EventT eventId, sdrplay_api_TunerSelectT tuner, sdrplay_api_EventParamsT *params);
 
+    int callbackStarted(void);
+
+    void callbackDone(const int epoch);
+
+    void waitForCallbacks(void);
+
     /*******************************************************************
      * public utility static methods
      ******************************************************************/
@@ -259,10 +306,32 @@ private:
 
     double getInputSampleRateAndDecimation(uint32_t output_sample_rate, unsigned int *decM, unsigned int *decEnable, sdrplay_api_If_kHzT *ifType) const;
 
+    uint32_t getResampledInputRate(uint32_t output_sample_rate) const;
+
+    double getBasebandFrequencyLimit(void) const;
+
+    bool setRfFrequency(double frequency, const bool wait = true);
+
+    void applyFrequency(const std::string &name, const double frequency, const bool wait = true);
+
+    void applyGain(const std::string &name, const double value, const bool wait = true);
+
+    bool scheduleCommand(const long long timeNs, const int type, const std::string &name, const double value);
+
+    void signalTimedCommands(const long long timeNs);
+
+    void commandLoop(void);
+
+    void stopCommands(void);
+
+    void clearTimedCommands(void);
+
     static sdrplay_api_Bw_MHzT getBwEnumForRate(double output_sample_rate);
 
     static double getBwValueFromEnum(sdrplay_api_Bw_MHzT bwEnum);
 
+    unsigned int getAdcBits(void) const;
+
     void selectDevice(const std::string &serial, const std::string &mode, const std::string &antenna);
 
     void selectDevice();
@@ -274,6 +343,36 @@ private:
 
     void releaseDevice();
 
+    void stopStreaming(void);
+
+    void startTeardown(void);
+
+    void cancelTeardown(void);
+
+    void teardownLoop(void);
+
+    bool waitForChanged(const std::atomic_int &changed);
+
+    int acquireRingBuffer(SoapySDRPlayStream *stream,
+                          size_t &handle,
+                          const void **buffs,
+                          int &flags,
+                          long long &timeNs,
+                          const long timeoutUs);
+
+    int readStreamDirect(SoapySDRPlayStream *stream,
+                         void * const *buffs,
+                         const size_t numElems,
+                         int &flags,
+                         long long &timeNs,
+                         const long timeoutUs);
+
+    void startSweep(SoapySDRPlayStream *stream);
+
+    void stopSweep();
+
+    void sweepLoop(const std::vector<double> frequencies, const double dwellUs);
+
 #ifdef SHOW_SERIAL_NUMBER_IN_MESSAGES
     void SoapySDR_log(const SoapySDRLogLevel logLevel, const char *message) const;
     void SoapySDR_logf(const SoapySDRLogLevel logLevel, const char *format, ...) const;
@@ -295,29 +394,99 @@ private:
     //  - serial number/S for the RSPduo in slave mode
     std::string rspDeviceId;
 
-    //cached settings
-    std::atomic_ulong bufferLength;
-
-    //numBuffers, bufferElems, elementsPerSample
-    //are indeed constants
-    const size_t numBuffers = DEFAULT_NUM_BUFFERS;
-    const unsigned int bufferElems = DEFAULT_BUFFER_LENGTH;
+    //elementsPerSample is indeed a constant; the number of buffers
+    //and their length are stream args (see setupStream())
     const int elementsPerSample = DEFAULT_ELEMS_PER_SAMPLE;
 
-    std::atomic_uint shortsPerWord;
- 
     std::atomic_bool streamActive;
-
-    std::atomic_bool useShort;
+    // 'standby' setting: the tuner keeps streaming after the last
+    // closeStream(), and rx_callback drops the samples until a stream
+    // is activated again
+    bool standby;
+
+    // output sample rate used to turn the hardware sample counter
+    // into timestamps (0 if unknown)
+    std::atomic<double> outputSampleRate;
+    // software resampling set up by setSampleRate() for the rates the API
+    // does not support (none otherwise); rx_callback picks a new one up
+    // when resamplerGeneration changes
+    std::shared_ptr<const SoapySDRPlayResampler::Design> resamplerDesign;
+    std::atomic<unsigned int> resamplerGeneration;
+    mutable std::mutex resampler_mutex;
+    // software frequency shift ("BB" frequency) of the samples, relative
+    // to the RF frequency
+    std::atomic<double> basebandFrequency;
+    // time of the latest sample received (without timeOffsetNs)
+    std::atomic<long long> hardwareTimeNs;
+    // offset set by setHardwareTime()
+    std::atomic<long long> timeOffsetNs;
+
+    // interleave/convert kernels selected for this CPU
+    const SoapySDRPlayConverters *converters;
 
     const int uninitRetryDelay = 10;   // 10 seconds before trying uninit again 
 
     static std::unordered_map<std::string, sdrplay_api_DeviceT*> selectedRSPDevices;
 
-    // RX callback reporting changes to gain reduction, frequency, sample rate
-    int gr_changed;
-    int rf_changed;
-    int fs_changed;
+    // RX callback reporting changes to gain reduction, frequency, sample rate;
+    // update_cond is notified when one of them is set (see waitForChanged())
+    std::atomic_int gr_changed;
+    std::atomic_int rf_changed;
+    std::atomic_int fs_changed;
+    std::mutex update_mutex;
+    std::condition_variable update_cond;
+
+    // frequency sweep scheduler (see sweepLoop()) for the stream
+    // set up with the 'sweep' stream arg
+    std::thread sweepThread;
+    SoapySDRPlayStream *sweepStream;
+    bool sweepRunning;
+    std::mutex sweep_mutex;
+    std::condition_variable sweep_cond;
+    // Uninit() in the background after the last closeStream() (see
+    // teardownLoop()), retried every uninitRetryDelay seconds while an
+    // RSPduo slave is still streaming; _general_state_mutex is only held
+    // while Uninit() is called, and activateStream() cancels it;
+    // teardownThread is only started or joined with teardown_thread_mutex
+    enum TeardownState
+    {
+        TEARDOWN_NONE,
+        TEARDOWN_PENDING,
+        TEARDOWN_DONE,
+        TEARDOWN_CANCELLED,
+        TEARDOWN_FAILED
+    };
+    std::thread teardownThread;
+    std::mutex teardown_thread_mutex;
+    std::atomic_int teardownState;
+    bool teardownCancel;
+    std::mutex teardown_mutex;
+    std::condition_variable teardown_cond;
+    // timed frequency and gain changes (setCommandTime() or the TIME
+    // frequency arg), in the order they are due; the first callback that
+    // reaches the time of a command stores it in commandDueNs, and
+    // commandLoop() makes the commands due by then
+    struct TimedCommand
+    {
+        enum Type { FREQUENCY, GAIN };
+        long long timeNs;
+        int type;
+        std::string name;
+        double value;
+    };
+    std::vector<TimedCommand> timedCommands;
+    std::thread commandThread;
+    bool commandRunning;
+    std::mutex command_mutex;
+    std::condition_variable command_cond;
+    // time of the first command in the queue (LLONG_MAX if none)
+    std::atomic<long long> nextCommandTimeNs;
+    // time the commands are due by (LLONG_MIN if none are)
+    std::atomic<long long> commandDueNs;
+    // bumped by clearTimedCommands(), so that commands taken off the
+    // queue before it are not made after it
+    std::atomic_uint commandGeneration;
+    std::atomic<long long> commandTimeNs;
     // event callback reporting device is unavailable
     bool device_unavailable;
     const int updateTimeout = 500;   // 500ms timeout for updates
@@ -333,31 +502,275 @@ public:
     class SoapySDRPlayStream
     {
     public:
-        SoapySDRPlayStream(size_t channel, size_t numBuffers, unsigned long bufferLength);
+        SoapySDRPlayStream(size_t channel, size_t numChannels, size_t numBuffers, unsigned long bufferSize,
+                           size_t bufferElems, bool scaleWithDecimation,
+                           bool useHugePages = false, bool lockMemory = false);
         ~SoapySDRPlayStream(void);
 
         size_t channel;
+        // 2 for both RSPduo tuners in one stream (channel is then 0)
+        size_t numChannels;
 
+        // the mutex and the condition variable are only used when
+        // the reader has to sleep waiting for a buffer; rx_callback
+        // takes the mutex only if readerWaiting is set
         std::mutex mutex;
         std::condition_variable cond;
-
-        std::vector<std::vector<short> > buffs;
-        size_t      head;
-        size_t      tail;
-        /// number of in-flight buffers
-        size_t      count;
-        short *currentBuff;
-        bool overflowEvent;
+        std::atomic_bool readerWaiting;
+
+        // single producer (rx_callback) / single consumer (acquireReadBuffer
+        // and releaseReadBuffer) ring of buffers:
+        //  - tail: number of buffers filled by rx_callback (producer owned)
+        //  - head: number of buffers released by the reader (consumer owned)
+        //  - acquired: number of buffers handed out to the reader; with
+        //    the drop oldest overflow policy rx_callback may also advance
+        //    it (and head) to take back the oldest buffer, but only when
+        //    the reader does not hold any buffer (acquired == head)
+        // tail and head are free running counters; the slot in buffs is
+        // the counter modulo the number of buffers
+        // each buffer holds numChannels channels, channelStride bytes apart
+        std::vector<char *> buffs;
+        size_t channelStride;
+
+        // stream format, and the size of a complex sample in it
+        enum Format
+        {
+            FORMAT_CS16,
+            FORMAT_CF32,
+            FORMAT_CS12,
+            FORMAT_CS8
+        };
+        Format      format;
+        size_t      bytesPerSample;
+        // CS8: right shift of the 16 bit samples, or -1 for block floating
+        // point, where each buffer gets the shift that fits the peak of the
+        // callback starting it, and is handed over early if a later
+        // callback needs a larger one
+        int         cs8Shift;
+        // format of the samples in the stream buffers: with
+        // directaccess=false CF32 is kept there as CS16 and converted by
+        // readStream() straight into the caller's buffers
+        Format      ringFormat;
+        size_t      ringBytesPerSample;
+        // what rx_callback knows about each filled buffer
+        struct BufferInfo
+        {
+            size_t length;     // number of samples
+            int flags;         // SOAPY_SDR_HAS_TIME if timeNs is valid
+            long long timeNs;  // time of the first sample
+            size_t lost;       // samples lost right before this buffer
+            size_t usbLost;    // samples lost before rx_callback got them (SDRPLAY_USB_LOSS_FLAG)
+            double frequency;  // RF frequency the samples were captured at
+        };
+        std::vector<BufferInfo> buffsInfo;
+        // number of samples rx_callback has written in the buffer at tail
+        size_t      fill;
+        // number of samples per buffer (the ring is sized for it); when
+        // scaleWithDecimation is set, rx_callback hands buffers over
+        // after bufferElems / decimation factor samples
+        size_t      bufferElems;
+        bool        scaleWithDecimation;
+        // number of samples per buffer handed over with the given
+        // decimation factor and software resampling (if any)
+        size_t effectiveBufferElems(unsigned int decimationFactor,
+                                    const SoapySDRPlayResampler::Design *resampleDesign) const;
+
+        // what rx_callback does when the ring is full
+        enum OverflowPolicy
+        {
+            OVERFLOW_DROP_NEWEST, // drop the incoming samples
+            OVERFLOW_DROP_OLDEST, // reuse the oldest buffer not held by the reader
+            OVERFLOW_FLUSH        // drop the incoming samples and drain the ring
+        };
+        OverflowPolicy overflowPolicy;
+        // samples dropped by rx_callback since the last buffer was started
+        // (rx_callback owned)
+        size_t      pendingLost;
+        // samples missing in the hardware sample counter since the last
+        // buffer was started (rx_callback owned)
+        size_t      pendingUsbLost;
+        // samples drained by a flush and not reported yet (reader owned)
+        size_t      flushedLost;
+
+        // streaming telemetry (readSetting("stream_stats")); every counter
+        // has a single writer, so rx_callback and the reader update them
+        // with relaxed loads and stores, without locks
+        struct Stats
+        {
+            // rx_callback owned
+            std::atomic<unsigned long long> callbacks;        // both tuners in a dual tuner stream
+            std::atomic<unsigned long long> samplesReceived;
+            std::atomic<unsigned long long> callbackNs;       // total time spent in rx_callback
+            std::atomic<unsigned long long> callbackNsMin;
+            std::atomic<unsigned long long> callbackNsMax;
+            std::atomic<unsigned long long> queueDepthMax;    // filled buffers
+            std::atomic<unsigned long long> usbGaps;          // jumps in firstSampleNum
+            std::atomic<unsigned long long> usbLostSamples;
+            std::atomic<unsigned long long> samplesDropped;   // lost to overflows in rx_callback
+            // reader owned
+            std::atomic<unsigned long long> samplesDelivered;
+            std::atomic<unsigned long long> overflows;        // SOAPY_SDR_OVERFLOW returned
+            std::atomic<unsigned long long> resets;
+            std::atomic<unsigned long long> samplesFlushed;   // lost to overflow flushes
+        };
+        Stats stats;
+        // the counters at the last writeSetting("stream_stats_reset")
+        // (guarded by _general_state_mutex); rx_callback clears the
+        // minimum and maximum values when it finds statsResetPending
+        struct StatsBase
+        {
+            unsigned long long callbacks;
+            unsigned long long samplesReceived;
+            unsigned long long callbackNs;
+            unsigned long long samplesDelivered;
+            unsigned long long samplesDropped;
+            unsigned long long overflows;
+            unsigned long long resets;
+            unsigned long long usbGaps;
+            unsigned long long usbLostSamples;
+        };
+        StatsBase statsBase;
+        std::atomic_bool statsResetPending;
+
+        // RF frequency of the samples rx_callback receives; it changes with
+        // the callback reporting rfChanged, and a buffer is handed over early
+        // at that point so that buffers never span a frequency change
+        double      frequency;
+        // RF frequency of the buffer last handed out to the reader
+        std::atomic<double> readFrequency;
+        // frequency sweep ('sweep' and 'dwell' stream args)
+        std::vector<double> sweepFrequencies;
+        double      sweepDwellUs;
+
+        // what the callback for the first channel did, so that the callback
+        // for the second channel writes its samples in the same positions
+        // (rx_callback owned)
+        bool        pairValid;
+        unsigned int pairSampleNum;
+        unsigned int pairNumSamples;
+        size_t      pairDirect;
+        size_t      pairElems;
+        size_t      pairBufferElems;
+        unsigned int pairSkip;
+        bool        pairBurstEnd;
+
+        // zero copy readStream ('zerocopy' stream arg): a reader that finds
+        // the ring empty lends its own buffers to rx_callback, which then
+        // converts the next buffer straight into them
+        //  - POSTED: directBuffs and directElems are set by the reader
+        //  - CLAIMED: rx_callback is filling directBuffs (between callbacks)
+        //  - WRITING: rx_callback is writing into directBuffs right now (within
+        //    one callback, and it wakes up a waiting reader when it is done)
+        //  - DONE: directBuffs hold directInfo.length samples
+        // the reader takes its buffers back by moving the state to IDLE,
+        // which it can do from any state but WRITING
+        enum DirectState
+        {
+            DIRECT_IDLE,
+            DIRECT_POSTED,
+            DIRECT_CLAIMED,
+            DIRECT_WRITING,
+            DIRECT_DONE
+        };
+        bool        zeroCopy;
+        std::atomic_int directState;
+        void       *directBuffs[2];
+        size_t      directElems;
+        BufferInfo  directInfo;
+        // rx_callback owned: directBuffs are being filled (fill is then the
+        // number of samples in them) up to directLimit samples
+        bool        directActive;
+        size_t      directLimit;
+
+        // buffers drained by a reset or a flush while the reader still held
+        // older buffers, as (first buffer, count) in ring order: each run
+        // goes back to rx_callback once the reader has released everything
+        // before it (reader owned)
+        std::vector<std::pair<size_t, size_t>> drains;
+
+        // hardware sample counter (rx_callback owned); firstSampleNum
+        // is a 32 bit counter, sampleCount is its unwrapped value, and
+        // timestamps are baseTimeNs plus the time of the samples counted
+        // after baseSampleCount at counterRate; the counter is expected
+        // to advance by lastNumSamples times the decimation factor, and
+        // anything more is samples lost before they reached rx_callback
+        // (oldDecimation is the factor before the last change, until the
+        // counter shows the new one)
+        bool        sampleCountValid;
+        unsigned int lastSampleNum;
+        unsigned int lastNumSamples;
+        unsigned int decimation;
+        unsigned int oldDecimation;
+        unsigned long long sampleCount;
+        unsigned long long baseSampleCount;
+        long long   baseTimeNs;
+        double      counterRate;
+        // set for a stream activated while the tuner is in standby, where
+        // the counter does not start over: its first callback is time 0
+        bool        counterRestart;
+
+        // software resampling of each channel (rx_callback owned); after
+        // a restart the buffers get the time of the first input sample
+        // plus resampleCount samples at the output rate
+        SoapySDRPlayResampler resamplers[2];
+        std::shared_ptr<const SoapySDRPlayResampler::Design> resampleDesign;
+        unsigned int resampleGeneration;
+        bool        resampleRestart;
+        long long   resampleTimeNs;
+        unsigned long long resampleCount;
+
+        // software frequency shift of each channel (rx_callback owned); the
+        // oscillators keep running when the shift changes, so that the
+        // phase stays continuous; the formats other than CS16 are shifted
+        // into mixI and mixQ before they are converted
+        SoapySDRPlayNco ncos[2];
+        std::vector<short> mixI;
+        std::vector<short> mixQ;
+
+        std::atomic_size_t head;
+        std::atomic_size_t tail;
+        std::atomic_size_t acquired;
+        char *currentBuff;
+        std::atomic_bool overflowEvent;
         std::atomic_size_t nElems;
         size_t currentHandle;
         std::atomic_bool reset;
+        // set by deactivateStream(): rx_callback drops the samples, and
+        // sets wasPaused (as does a timed or burst activateStream()) so
+        // that the first callback after activateStream() starts a buffer;
+        // with resumeFlush activateStream() drains the queue too
+        std::atomic_bool paused;
+        std::atomic_bool wasPaused;
+        bool        resumeFlush;
+        // timed activation and bursts (activateStream() flags), set while
+        // the stream is paused (with no callback running) or not activated
+        // yet, and published by clearing paused: rx_callback drops the
+        // samples before startTimeNs, and after burstRemaining samples it
+        // hands the last buffer over with SOAPY_SDR_END_BURST and pauses
+        bool        timedStart;
+        long long   startTimeNs;
+        size_t      burstRemaining;
 
         // fv
         std::mutex anotherMutex;
+
+        // all the buffers are fixed slots carved out of one contiguous,
+        // page aligned memory area, so their addresses do not change
+        // for the lifetime of the stream
+        void *arena;
+        size_t arenaSize;
     };
 
-    SoapySDRPlayStream *_streams[2];
+    std::atomic<SoapySDRPlayStream *> _streams[2];
     int _streamsRefCount[2];
+    // rx_callback calls running right now, counted apart by the epoch
+    // they started in, so that waitForCallbacks() only waits for the ones
+    // already running (callbacksWaiting: someone is waiting)
+    std::atomic_int callbacksInFlight[2];
+    std::atomic_int callbackEpoch;
+    std::atomic_bool callbacksWaiting;
+    std::mutex callbacks_mutex;
+    std::condition_variable callbacks_cond;
 
     constexpr static double defaultRspDuoSampleFreq = 6000000;
     constexpr static double defaultRspDuoOutputSampleRate = 2000000;
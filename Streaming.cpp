@@ -26,11 +26,31 @@
 
 #include "SoapySDRPlay.hpp"
 #include <iostream>
+#include <cmath>
+#include <climits>
+#include <SoapySDR/Time.hpp>
+#include <sstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// value of SoapySDRPlayStream::acquired while rx_callback
+// takes back the oldest buffer (drop oldest overflow policy)
+static const size_t ACQUIRED_LOCKED = ~(size_t)0;
 
 std::vector<std::string> SoapySDRPlay::getStreamFormats(const int direction, const size_t channel) const
 {
     std::vector<std::string> formats;
 
+    formats.push_back("CS8");
+    formats.push_back("CS12");
     formats.push_back("CS16");
     formats.push_back("CF32");
 
@@ -39,6 +59,9 @@ std::vector<std::string> SoapySDRPlay::getStreamFormats(const int direction, con
 
 std::string SoapySDRPlay::getNativeStreamFormat(const int direction, const size_t channel, double &fullScale) const
 {
+     // CS12 holds all the bits of the 12 bit ADC models too (see
+     // getStreamFormats() and the adc_bits hardware info), but CS16
+     // stays native, so that existing clients keep format and scaling
      fullScale = 32767;
      return "CS16";
 }
@@ -47,6 +70,116 @@ SoapySDR::ArgInfoList SoapySDRPlay::getStreamArgsInfo(const int direction, const
 {
     SoapySDR::ArgInfoList streamArgs;
 
+    SoapySDR::ArgInfo BuffersArg;
+    BuffersArg.key = "buffers";
+    BuffersArg.value = std::to_string(DEFAULT_NUM_BUFFERS);
+    BuffersArg.name = "Buffers";
+    BuffersArg.description = "Number of buffers in the stream queue";
+    BuffersArg.type = SoapySDR::ArgInfo::INT;
+    streamArgs.push_back(BuffersArg);
+
+    SoapySDR::ArgInfo BufflenArg;
+    BufflenArg.key = "bufflen";
+    BufflenArg.value = std::to_string(DEFAULT_BUFFER_LENGTH);
+    BufflenArg.name = "Buffer Length";
+    BufflenArg.description = "Number of samples per buffer (stream MTU); by default buffers get shorter with decimation";
+    BufflenArg.units = "samples";
+    BufflenArg.type = SoapySDR::ArgInfo::INT;
+    streamArgs.push_back(BufflenArg);
+
+    SoapySDR::ArgInfo LatencyArg;
+    LatencyArg.key = "latency";
+    LatencyArg.value = "0";
+    LatencyArg.name = "Latency";
+    LatencyArg.description = "Buffer latency target; sets the buffer length from the current sample rate (ignored if bufflen is set)";
+    LatencyArg.units = "us";
+    LatencyArg.type = SoapySDR::ArgInfo::FLOAT;
+    streamArgs.push_back(LatencyArg);
+
+    SoapySDR::ArgInfo HugePagesArg;
+    HugePagesArg.key = "hugepages";
+    HugePagesArg.value = "false";
+    HugePagesArg.name = "Huge Pages";
+    HugePagesArg.description = "Allocate the stream buffers in huge pages";
+    HugePagesArg.type = SoapySDR::ArgInfo::BOOL;
+    streamArgs.push_back(HugePagesArg);
+
+    SoapySDR::ArgInfo MlockArg;
+    MlockArg.key = "mlock";
+    MlockArg.value = "false";
+    MlockArg.name = "Lock Memory";
+    MlockArg.description = "Lock the stream buffers in memory";
+    MlockArg.type = SoapySDR::ArgInfo::BOOL;
+    streamArgs.push_back(MlockArg);
+
+    SoapySDR::ArgInfo OverflowArg;
+    OverflowArg.key = "overflow";
+    OverflowArg.value = "drop_newest";
+    OverflowArg.name = "Overflow Policy";
+    OverflowArg.description = "What to drop when the stream queue is full: the incoming samples, the oldest queued buffer, or everything queued (flush)";
+    OverflowArg.type = SoapySDR::ArgInfo::STRING;
+    OverflowArg.options.push_back("drop_newest");
+    OverflowArg.options.push_back("drop_oldest");
+    OverflowArg.options.push_back("flush");
+    OverflowArg.optionNames.push_back("Drop Newest");
+    OverflowArg.optionNames.push_back("Drop Oldest");
+    OverflowArg.optionNames.push_back("Flush");
+    streamArgs.push_back(OverflowArg);
+
+    SoapySDR::ArgInfo ZeroCopyArg;
+    ZeroCopyArg.key = "zerocopy";
+    ZeroCopyArg.value = "false";
+    ZeroCopyArg.name = "Zero Copy";
+    ZeroCopyArg.description = "Let readStream() receive the samples directly in its buffers when it is waiting for data";
+    ZeroCopyArg.type = SoapySDR::ArgInfo::BOOL;
+    streamArgs.push_back(ZeroCopyArg);
+
+    SoapySDR::ArgInfo DirectAccessArg;
+    DirectAccessArg.key = "directaccess";
+    DirectAccessArg.value = "true";
+    DirectAccessArg.name = "Direct Access";
+    DirectAccessArg.description = "CF32 format: keep CF32 in the stream buffers so that they can be read with acquireReadBuffer(); 'false' keeps CS16 there instead (half the memory, converted by readStream()) for applications that only use readStream()";
+    DirectAccessArg.type = SoapySDR::ArgInfo::BOOL;
+    streamArgs.push_back(DirectAccessArg);
+
+    SoapySDR::ArgInfo SweepArg;
+    SweepArg.key = "sweep";
+    SweepArg.value = "";
+    SweepArg.name = "Frequency Sweep";
+    SweepArg.description = "Comma separated list of RF frequencies to step through while streaming; readSetting(\"buffer_frequency\") tells the frequency of the samples last read";
+    SweepArg.units = "Hz";
+    SweepArg.type = SoapySDR::ArgInfo::STRING;
+    streamArgs.push_back(SweepArg);
+
+    SoapySDR::ArgInfo DwellArg;
+    DwellArg.key = "dwell";
+    DwellArg.value = "10000";
+    DwellArg.name = "Dwell Time";
+    DwellArg.description = "Time spent on each frequency of the sweep, counted from when the tuner reports the change";
+    DwellArg.units = "us";
+    DwellArg.type = SoapySDR::ArgInfo::FLOAT;
+    streamArgs.push_back(DwellArg);
+
+    SoapySDR::ArgInfo ResumeArg;
+    ResumeArg.key = "resume";
+    ResumeArg.value = "keep";
+    ResumeArg.name = "Resume";
+    ResumeArg.description = "What activateStream() does with the buffers queued before deactivateStream() paused the stream: keep them for the reader, or flush them so that reading starts from the samples after the pause";
+    ResumeArg.type = SoapySDR::ArgInfo::STRING;
+    ResumeArg.options.push_back("keep");
+    ResumeArg.options.push_back("flush");
+    ResumeArg.optionNames.push_back("Keep");
+    ResumeArg.optionNames.push_back("Flush");
+    streamArgs.push_back(ResumeArg);
+
+    SoapySDR::ArgInfo Cs8ShiftArg;
+    Cs8ShiftArg.key = "cs8shift";
+    Cs8ShiftArg.value = "8";
+    Cs8ShiftArg.name = "CS8 Scale";
+    Cs8ShiftArg.description = "CS8 format: right shift (0 to 8) of the 16 bit samples, or 'auto' for block floating point with a shift per buffer (a buffer ends early when the signal needs a larger shift); readStream() returns the shift in the flags (see SDRPLAY_CS8_EXPONENT)";
+    Cs8ShiftArg.type = SoapySDR::ArgInfo::STRING;
+    streamArgs.push_back(Cs8ShiftArg);
+
     return streamArgs;
 }
 
@@ -58,14 +191,53 @@ static void _rx_callback_A(short *xi, short *xq, sdrplay_api_StreamCbParamsT *pa
                            unsigned int numSamples, unsigned int reset, void *cbContext)
 {
     SoapySDRPlay *self = (SoapySDRPlay *)cbContext;
-    return self->rx_callback(xi, xq, params, numSamples, self->_streams[0]);
+    // closeStream() waits for the callbacks in flight before it deletes a stream
+    const int epoch = self->callbackStarted();
+    self->rx_callback(xi, xq, params, numSamples, reset, self->_streams[0], 0);
+    self->callbackDone(epoch);
 }
 
 static void _rx_callback_B(short *xi, short *xq, sdrplay_api_StreamCbParamsT *params,
                            unsigned int numSamples, unsigned int reset, void *cbContext)
 {
     SoapySDRPlay *self = (SoapySDRPlay *)cbContext;
-    return self->rx_callback(xi, xq, params, numSamples, self->_streams[1]);
+    const int epoch = self->callbackStarted();
+    self->rx_callback(xi, xq, params, numSamples, reset, self->_streams[1], 1);
+    self->callbackDone(epoch);
+}
+
+int SoapySDRPlay::callbackStarted(void)
+{
+    const int epoch = callbackEpoch;
+    callbacksInFlight[epoch]++;
+    return epoch;
+}
+
+void SoapySDRPlay::callbackDone(const int epoch)
+{
+    if (--callbacksInFlight[epoch] == 0 && callbacksWaiting)
+    {
+        std::lock_guard<std::mutex> lock(callbacks_mutex);
+        callbacks_cond.notify_all();
+    }
+}
+
+// returns once the rx_callback calls running when it was called have
+// returned: the epoch is switched, so that the callbacks starting from
+// now on are counted apart and cannot keep it waiting, and it is done
+// twice to also catch a callback that read the epoch before the switch
+// but counted itself only after it
+void SoapySDRPlay::waitForCallbacks(void)
+{
+    std::unique_lock<std::mutex> lock(callbacks_mutex);
+    callbacksWaiting = true;
+    for (int i = 0; i < 2; ++i)
+    {
+        const int epoch = callbackEpoch;
+        callbackEpoch = 1 - epoch;
+        callbacks_cond.wait(lock, [this, epoch]{ return callbacksInFlight[epoch] == 0; });
+    }
+    callbacksWaiting = false;
 }
 
 static void _ev_callback(sdrplay_api_EventT eventId, sdrplay_api_TunerSelectT tuner,
@@ -75,82 +247,816 @@ static void _ev_callback(sdrplay_api_EventT eventId, sdrplay_api_TunerSelectT tu
     return self->ev_callback(eventId, tuner, params);
 }
 
+// the stream telemetry counters have a single writer each,
+// so they do not need read-modify-write operations
+static inline void statsAdd(std::atomic<unsigned long long> &counter, unsigned long long n)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+static inline void statsMax(std::atomic<unsigned long long> &counter, unsigned long long value)
+{
+    if (value > counter.load(std::memory_order_relaxed))
+    {
+        counter.store(value, std::memory_order_relaxed);
+    }
+}
+
+// accounts the time spent in rx_callback, whichever way it returns
+class CallbackTimer
+{
+public:
+    explicit CallbackTimer(SoapySDRPlay::SoapySDRPlayStream::Stats &stats):
+        stats(stats),
+        start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~CallbackTimer()
+    {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        // 0 is 'no callback yet' for the minimum
+        unsigned long long ns = std::max((long long)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), 1LL);
+        statsAdd(stats.callbacks, 1);
+        statsAdd(stats.callbackNs, ns);
+        unsigned long long minNs = stats.callbackNsMin.load(std::memory_order_relaxed);
+        if (minNs == 0 || ns < minNs)
+        {
+            stats.callbackNsMin.store(ns, std::memory_order_relaxed);
+        }
+        statsMax(stats.callbackNsMax, ns);
+    }
+
+private:
+    SoapySDRPlay::SoapySDRPlayStream::Stats &stats;
+    std::chrono::steady_clock::time_point start;
+};
+
+// converts numSamples samples into the given format; flags are the
+// flags of the buffer they go in (CS8 exponent), and nco the frequency
+// shift fused with the conversion into CS16 (none if null)
+static inline void convertSamples(const SoapySDRPlayConverters *converters,
+                                  SoapySDRPlay::SoapySDRPlayStream::Format format, int flags,
+                                  const short *xi, const short *xq, void *out, unsigned int numSamples,
+                                  SoapySDRPlayNco *nco)
+{
+    switch (format)
+    {
+    case SoapySDRPlay::SoapySDRPlayStream::FORMAT_CS16:
+        if (nco)
+        {
+            converters->mixToCS16(xi, xq, out, numSamples, nco);
+        }
+        else
+        {
+            converters->toCS16(xi, xq, out, numSamples);
+        }
+        break;
+    case SoapySDRPlay::SoapySDRPlayStream::FORMAT_CF32:
+        converters->toCF32(xi, xq, out, numSamples);
+        break;
+    case SoapySDRPlay::SoapySDRPlayStream::FORMAT_CS12:
+        converters->toCS12(xi, xq, out, numSamples);
+        break;
+    case SoapySDRPlay::SoapySDRPlayStream::FORMAT_CS8:
+        converters->toCS8(xi, xq, out, numSamples, SDRPLAY_CS8_EXPONENT(flags));
+        break;
+    }
+}
+
+// copies numSamples samples of a stream buffer into the caller's buffer,
+// converting the CS16 kept for a CF32 stream
+static inline void copyFromRing(const SoapySDRPlayConverters *converters,
+                                const SoapySDRPlay::SoapySDRPlayStream *stream,
+                                const char *in, void *out, size_t numSamples)
+{
+    if (stream->ringFormat == stream->format)
+    {
+        std::memcpy(out, in, numSamples * stream->bytesPerSample);
+    }
+    else
+    {
+        converters->cs16ToCF32((const short *)in, out, (unsigned int)numSamples);
+    }
+}
+
+// the frequency shift can be fused with the conversion only if all the
+// samples go into CS16 buffers
+static inline bool fusedFrequencyShift(const SoapySDRPlay::SoapySDRPlayStream *stream)
+{
+    return stream->ringFormat == SoapySDRPlay::SoapySDRPlayStream::FORMAT_CS16 &&
+           (stream->format == SoapySDRPlay::SoapySDRPlayStream::FORMAT_CS16 || !stream->zeroCopy);
+}
+
+// frequency shift of the samples of a channel ahead of the conversion;
+// xi and xq then point to the shifted samples
+static inline void shiftFrequency(const SoapySDRPlayConverters *converters,
+                                  SoapySDRPlay::SoapySDRPlayStream *stream, size_t chan,
+                                  short *&xi, short *&xq, unsigned int numSamples)
+{
+    if (stream->mixI.size() < numSamples)
+    {
+        stream->mixI.resize(numSamples);
+        stream->mixQ.resize(numSamples);
+    }
+    converters->mix(xi, xq, stream->mixI.data(), stream->mixQ.data(), numSamples, &stream->ncos[chan]);
+    xi = stream->mixI.data();
+    xq = stream->mixQ.data();
+}
+
+// smallest CS8 shift that keeps the peak value from saturating
+static inline unsigned int cs8ExponentForPeak(unsigned int peak)
+{
+    unsigned int shift = 0;
+    while (shift < 8 && (peak + (1u << shift >> 1)) >> shift > 127)
+    {
+        shift++;
+    }
+    return shift;
+}
+
 void SoapySDRPlay::rx_callback(short *xi, short *xq,
                                sdrplay_api_StreamCbParamsT *params,
                                unsigned int numSamples,
-                               SoapySDRPlayStream *stream)
+                               unsigned int reset,
+                               SoapySDRPlayStream *stream,
+                               size_t tuner)
 {
-    if (stream == 0) {
-        return;
-    }
-    std::lock_guard<std::mutex> lock(stream->mutex);
-
+    bool updated = false;
     if (gr_changed == 0 && params->grChanged != 0)
     {
         gr_changed = params->grChanged;
+        updated = true;
     }
     if (rf_changed == 0 && params->rfChanged != 0)
     {
         rf_changed = params->rfChanged;
+        updated = true;
     }
     if (fs_changed == 0 && params->fsChanged != 0)
     {
         fs_changed = params->fsChanged;
+        updated = true;
+    }
+    if (updated)
+    {
+        // wake up the setting waiting for this update (if any)
+        std::lock_guard<std::mutex> lock(update_mutex);
+        update_cond.notify_all();
     }
 
-    if (stream->count == numBuffers)
+    // no stream (the tuner is in standby): the samples go nowhere
+    if (stream == 0) {
+        return;
+    }
+
+    // paused by deactivateStream() or at the end of a burst: the samples
+    // are dropped, and only the hardware sample counter is kept track of,
+    // so that the timestamps carry on from the real time of the samples
+    // after activateStream() (which sets up the timed start and the burst
+    // before it clears paused)
+    if (stream->paused.load(std::memory_order_acquire))
     {
-        stream->overflowEvent = true;
+        if ((stream->numChannels == 1 || tuner == 0) && stream->sampleCountValid)
+        {
+            stream->pairValid = false;
+            stream->sampleCount += params->firstSampleNum - stream->lastSampleNum;
+            stream->lastSampleNum = params->firstSampleNum;
+            stream->lastNumSamples = numSamples;
+            if (stream->counterRate > 0)
+            {
+                hardwareTimeNs = stream->baseTimeNs + SoapySDR::ticksToTimeNs(stream->sampleCount - stream->baseSampleCount +
+                                                                              (unsigned long long)numSamples * stream->decimation, stream->counterRate);
+            }
+            stream->wasPaused = true;
+            signalTimedCommands(hardwareTimeNs + timeOffsetNs);
+        }
+        else if (tuner == 1 && stream->directActive)
+        {
+            // tuner A went on with the buffers lent by the reader just
+            // before the pause: give them back with what both channels have
+            stream->directActive = false;
+            stream->fill = 0;
+            int expected = SoapySDRPlayStream::DIRECT_CLAIMED;
+            if (stream->directState.compare_exchange_strong(expected, SoapySDRPlayStream::DIRECT_DONE) &&
+                stream->readerWaiting)
+            {
+                std::lock_guard<std::mutex> lock(stream->mutex);
+                stream->cond.notify_one();
+            }
+        }
         return;
     }
 
-    int spaceReqd = numSamples * elementsPerSample * shortsPerWord;
-    if ((stream->buffs[stream->tail].size() + spaceReqd) >= (bufferLength / chParams->ctrlParams.decimation.decimationFactor))
+    if (stream->statsResetPending.load(std::memory_order_relaxed))
     {
-       // increment the tail pointer and buffer count
-       stream->tail = (stream->tail + 1) % numBuffers;
-       stream->count++;
+        stream->stats.callbackNsMin.store(0, std::memory_order_relaxed);
+        stream->stats.callbackNsMax.store(0, std::memory_order_relaxed);
+        stream->stats.queueDepthMax.store(0, std::memory_order_relaxed);
+        stream->statsResetPending = false;
+    }
+    CallbackTimer timer(stream->stats);
+
+
+    // with both RSPduo tuners in one stream, the callback for tuner A
+    // (the API always calls it first) decides where the samples go and
+    // the callback for tuner B writes the same positions in the second
+    // channel and hands the filled buffers over to the reader
+    const size_t chan = stream->numChannels == 1 ? 0 : tuner;
+    const bool firstChannel = chan == 0;
+    const bool lastChannel = chan + 1 == stream->numChannels;
+
+    const size_t numBuffers = stream->buffs.size();
+    const size_t bytesPerSample = stream->bytesPerSample;
+    const size_t ringBytesPerSample = stream->ringBytesPerSample;
+    size_t bufferElems;
+    size_t numDirect = 0;
+    size_t numElems;
+    bool burstEnd = false;
+
+    if (firstChannel)
+    {
+        statsAdd(stream->stats.samplesReceived, numSamples);
+
+        // the sample counter advances by the number of samples before
+        // decimation, i.e. at the output sample rate times the decimation factor
+        const unsigned int decimation = chParams->ctrlParams.decimation.enable ? chParams->ctrlParams.decimation.decimationFactor : 1;
+        if (decimation != stream->decimation)
+        {
+            // the API may take a few callbacks to apply the new factor
+            stream->oldDecimation = stream->decimation;
+            stream->decimation = decimation;
+        }
+
+        // pick up a new software resampling set up by setSampleRate()
+        if (stream->resampleGeneration != resamplerGeneration)
+        {
+            std::lock_guard<std::mutex> lock(resampler_mutex);
+            stream->resampleDesign = resamplerDesign;
+            stream->resampleGeneration = resamplerGeneration;
+            for (auto &resampler : stream->resamplers)
+            {
+                resampler.configure(stream->resampleDesign);
+            }
+            stream->resampleRestart = true;
+        }
+        const SoapySDRPlayResampler::Design *resampleDesign = stream->resampleDesign.get();
+
+        // keep track of the hardware sample counter; firstSampleNum is a
+        // 32 bit counter, so only the difference from the previous callback
+        // is meaningful
+        bool usbGap = false;
+        if (stream->sampleCountValid)
+        {
+            const unsigned int ticks = params->firstSampleNum - stream->lastSampleNum;
+            stream->sampleCount += ticks;
+
+            // a jump forward means samples were lost on USB or in the API,
+            // before they got here; the API restarts the stream when it sets
+            // reset, and a sample rate change may restart the counter too
+            const unsigned int expected = stream->lastNumSamples * decimation;
+            if (ticks == expected)
+            {
+                stream->oldDecimation = 0;
+            }
+            else if (stream->oldDecimation != 0 && ticks == stream->lastNumSamples * stream->oldDecimation)
+            {
+                // the new decimation factor is not in effect yet
+            }
+            else if (reset == 0 && params->fsChanged == 0 && !stream->reset &&
+                     ticks > expected && ticks < 0x80000000u)
+            {
+                const size_t lost = (ticks - expected) / decimation;
+                statsAdd(stream->stats.usbGaps, 1);
+                statsAdd(stream->stats.usbLostSamples, lost);
+                stream->pendingUsbLost += resampleDesign ? (size_t)((unsigned long long)lost * resampleDesign->outputRate / resampleDesign->inputRate) : lost;
+                usbGap = true;
+            }
+        }
+        else
+        {
+            stream->sampleCount = params->firstSampleNum;
+            stream->sampleCountValid = true;
+            if (stream->counterRestart)
+            {
+                stream->baseSampleCount = stream->sampleCount;
+                stream->counterRestart = false;
+            }
+        }
+        stream->lastSampleNum = params->firstSampleNum;
+        stream->lastNumSamples = numSamples;
+
+        // the new RF frequency applies from the first sample of the
+        // callback reporting rfChanged
+        const bool retuned = params->rfChanged != 0;
+        if (retuned)
+        {
+            stream->frequency = chParams->tunerParams.rfFreq.rfHz;
+        }
+
+        // first callback after a pause: the samples before it are gone
+        const bool resumed = stream->wasPaused;
+        if (resumed)
+        {
+            stream->resampleRestart = true;
+        }
+
+        // with software resampling the API delivers the samples at the
+        // rate the resampler starts from
+        const double apiSampleRate = resampleDesign ? (double)resampleDesign->inputRate : outputSampleRate.load();
+        const double counterRate = apiSampleRate * decimation;
+        if (counterRate != stream->counterRate)
+        {
+            stream->resampleRestart = true;
+            // sample rate change: keep the timeline continuous
+            if (stream->counterRate > 0)
+            {
+                stream->baseTimeNs += SoapySDR::ticksToTimeNs(stream->sampleCount - stream->baseSampleCount, stream->counterRate);
+                stream->baseSampleCount = stream->sampleCount;
+            }
+            stream->counterRate = counterRate;
+        }
+        const bool hasTime = counterRate > 0;
+        // buffers started by this callback get the CS8 exponent in their
+        // flags; with block floating point it comes from the peak of the
+        // callback, computed only if a buffer is started or being filled
+        int formatFlags = -1;
+        auto bufferFormatFlags = [&]() -> int
+        {
+            if (formatFlags < 0)
+            {
+                formatFlags = 0;
+                if (stream->format == SoapySDRPlayStream::FORMAT_CS8)
+                {
+                    const unsigned int exponent = stream->cs8Shift >= 0 ? stream->cs8Shift :
+                                                  cs8ExponentForPeak(converters->peak(xi, xq, numSamples));
+                    formatFlags = exponent << SDRPLAY_CS8_EXPONENT_SHIFT;
+                }
+            }
+            return formatFlags;
+        };
+        const long long timeOffset = timeOffsetNs;
+        // samples dropped at the beginning of the callback (timed activation)
+        unsigned int skipped = 0;
+        auto sampleTimeNs = [stream, decimation, &skipped](unsigned int offset) -> long long
+        {
+            return stream->baseTimeNs + SoapySDR::ticksToTimeNs(stream->sampleCount - stream->baseSampleCount + (unsigned long long)(skipped + offset) * decimation, stream->counterRate);
+        };
+        if (hasTime)
+        {
+            hardwareTimeNs = sampleTimeNs(numSamples);
+            // timed commands due by the end of this callback
+            signalTimedCommands(hardwareTimeNs + timeOffset);
+        }
+
+        // a reset is pending: discard everything until the reader drains the
+        // fifo; resuming with resume=flush discards the buffer being filled
+        // (the reader drains the rest)
+        if (stream->reset || (resumed && stream->resumeFlush))
+        {
+            if (stream->directActive)
+            {
+                // give the reader its buffers back empty
+                stream->directActive = false;
+                stream->directInfo.length = 0;
+                int expected = SoapySDRPlayStream::DIRECT_CLAIMED;
+                if (stream->directState.compare_exchange_strong(expected, SoapySDRPlayStream::DIRECT_DONE) &&
+                    stream->readerWaiting)
+                {
+                    std::lock_guard<std::mutex> lock(stream->mutex);
+                    stream->cond.notify_one();
+                }
+            }
+            stream->fill = 0;
+            stream->pendingLost = 0;
+            stream->pendingUsbLost = 0;
+            stream->pairValid = false;
+            stream->resampleRestart = true;
+            if (stream->reset)
+            {
+                return;
+            }
+        }
+
+        // software resampling: from here on the samples are the resampled
+        // ones, timed from the first input sample after a restart (the
+        // filters have no group delay)
+        const unsigned int receivedSamples = numSamples;
+
+        // timed activation: drop the samples before the start time; the
+        // stream (and the resampler) starts with the first one after it
+        if (stream->timedStart)
+        {
+            const long long waitNs = hasTime ? stream->startTimeNs - timeOffset - sampleTimeNs(0) : 0;
+            if (waitNs > 0)
+            {
+                const long long ticks = SoapySDR::timeNsToTicks(waitNs, apiSampleRate);
+                if (ticks >= numSamples)
+                {
+                    stream->pairValid = false;
+                    return;
+                }
+                skipped = (unsigned int)ticks;
+                xi += skipped;
+                xq += skipped;
+                numSamples -= skipped;
+            }
+            stream->timedStart = false;
+            stream->resampleRestart = true;
+        }
+
+        unsigned long long resampleIndex = 0;
+        if (resampleDesign)
+        {
+            if (stream->resampleRestart || usbGap || reset != 0)
+            {
+                for (auto &resampler : stream->resamplers)
+                {
+                    resampler.restart();
+                }
+                stream->resampleRestart = false;
+                stream->resampleTimeNs = hasTime ? sampleTimeNs(0) : 0;
+                stream->resampleCount = 0;
+            }
+            resampleIndex = stream->resampleCount;
+            numSamples = stream->resamplers[0].process(xi, xq, numSamples);
+            xi = stream->resamplers[0].outI();
+            xq = stream->resamplers[0].outQ();
+            stream->resampleCount += numSamples;
+        }
+
+        // burst: the samples after its end are dropped
+        if (stream->burstRemaining != 0)
+        {
+            if (numSamples >= stream->burstRemaining)
+            {
+                numSamples = (unsigned int)stream->burstRemaining;
+                burstEnd = true;
+            }
+            stream->burstRemaining -= numSamples;
+        }
+
+        // software frequency shift, at the rate of the samples from here on;
+        // the CS8 exponent has to fit the shifted samples
+        const double sampleRate = resampleDesign ? (double)resampleDesign->outputRate : apiSampleRate;
+        const double shift = basebandFrequency.load(std::memory_order_relaxed);
+        const double ncoStep = shift != 0 && sampleRate > 0 ? -shift / sampleRate : 0;
+        for (auto &nco : stream->ncos)
+        {
+            nco.step = ncoStep;
+        }
+        if (ncoStep != 0 && !fusedFrequencyShift(stream))
+        {
+            shiftFrequency(converters, stream, 0, xi, xq, numSamples);
+        }
+
+        auto bufferTimeNs = [&](unsigned int offset) -> long long
+        {
+            if (resampleDesign)
+            {
+                return stream->resampleTimeNs + SoapySDR::ticksToTimeNs(resampleIndex + offset, resampleDesign->outputRate);
+            }
+            return sampleTimeNs(offset);
+        };
+
+        bufferElems = stream->effectiveBufferElems(chParams->ctrlParams.decimation.decimationFactor, resampleDesign);
+
+        // block floating point: a buffer keeps the CS8 exponent it was
+        // started with, so samples that need a larger one start a new buffer
+        bool rescaled = false;
+        if (stream->fill != 0 && stream->format == SoapySDRPlayStream::FORMAT_CS8 && stream->cs8Shift < 0)
+        {
+            const int filling = stream->directActive ? stream->directInfo.flags :
+                                stream->buffsInfo[stream->tail.load(std::memory_order_relaxed) % numBuffers].flags;
+            rescaled = SDRPLAY_CS8_EXPONENT(bufferFormatFlags()) > SDRPLAY_CS8_EXPONENT(filling);
+        }
 
-       auto &buff = stream->buffs[stream->tail];
-       if (stream->count == numBuffers && (size_t) spaceReqd > buff.capacity() - buff.size())
-       {
-           stream->overflowEvent = true;
-           return;
-       }
+        // hand over what was received at the previous frequency, or before
+        // a gap or a pause, or at another scale, so that the samples after
+        // that start a buffer (with the right timestamp)
+        if ((retuned || usbGap || resumed || rescaled) && stream->fill != 0)
+        {
+            if (stream->directActive)
+            {
+                stream->directActive = false;
+                int expected = SoapySDRPlayStream::DIRECT_CLAIMED;
+                stream->directState.compare_exchange_strong(expected, SoapySDRPlayStream::DIRECT_DONE);
+            }
+            else
+            {
+                const size_t filled = stream->tail.load(std::memory_order_relaxed);
+                stream->buffsInfo[filled % numBuffers].length = stream->fill;
+                stream->tail = filled + 1;
+            }
+            stream->fill = 0;
+            if (stream->readerWaiting)
+            {
+                std::lock_guard<std::mutex> lock(stream->mutex);
+                stream->cond.notify_one();
+            }
+        }
+        stream->wasPaused = false;
+        size_t tail = stream->tail.load(std::memory_order_relaxed);
 
-       // notify readStream()
-       stream->cond.notify_one();
+        // zero copy: the reader waiting on an empty ring lent its own
+        // buffers, so the next buffer goes straight into them
+        if (stream->directActive)
+        {
+            int expected = SoapySDRPlayStream::DIRECT_CLAIMED;
+            if (!stream->directState.compare_exchange_strong(expected, SoapySDRPlayStream::DIRECT_WRITING))
+            {
+                // the reader took them back; carry on in the ring
+                stream->directActive = false;
+                stream->fill = 0;
+            }
+        }
+        else if (stream->zeroCopy && stream->pendingLost == 0 &&
+                 stream->acquired.load() == tail &&
+                 stream->directState == SoapySDRPlayStream::DIRECT_POSTED)
+        {
+            const size_t directLimit = std::min(stream->directElems, bufferElems);
+            const auto &info = stream->buffsInfo[tail % numBuffers];
+            int expected = SoapySDRPlayStream::DIRECT_POSTED;
+            if (stream->fill < directLimit && (stream->fill == 0 || info.lost == 0) &&
+                stream->directState.compare_exchange_strong(expected, SoapySDRPlayStream::DIRECT_WRITING))
+            {
+                stream->directActive = true;
+                stream->directLimit = directLimit;
+                if (stream->fill == 0)
+                {
+                    stream->directInfo.flags = (hasTime ? SOAPY_SDR_HAS_TIME : 0) | bufferFormatFlags() |
+                                               (stream->pendingUsbLost != 0 ? SDRPLAY_USB_LOSS_FLAG : 0);
+                    stream->directInfo.timeNs = hasTime ? bufferTimeNs(0) + timeOffset : 0;
+                    stream->directInfo.lost = 0;
+                    stream->directInfo.usbLost = stream->pendingUsbLost;
+                    stream->directInfo.frequency = stream->frequency;
+                    stream->pendingUsbLost = 0;
+                }
+                else
+                {
+                    // move the partially filled buffer over so that the
+                    // samples stay in order (after a zero copy buffer
+                    // this is just the rest of the previous callback)
+                    stream->directInfo = info;
+                    for (size_t i = 0; i < stream->numChannels; ++i)
+                    {
+                        copyFromRing(converters, stream,
+                                     stream->buffs[tail % numBuffers] + i * stream->channelStride,
+                                     stream->directBuffs[i], stream->fill);
+                    }
+                }
+                stream->directInfo.length = stream->fill;
+            }
+        }
+        if (stream->directActive)
+        {
+            numDirect = std::min((size_t)numSamples, stream->directLimit - stream->fill);
+        }
+
+        // the rest goes to the ring
+        const size_t ringSamples = numSamples - numDirect;
+        const size_t fill = stream->directActive ? 0 : std::min(stream->fill, bufferElems);
+
+        // the buffers from tail on are owned by this thread as long as the
+        // ring is not full; the buffer at tail may be partially filled
+        size_t head = stream->head.load(std::memory_order_acquire);
+        size_t needed = (fill + ringSamples + bufferElems - 1) / bufferElems;
+        while (numBuffers - (tail - head) < needed && head != tail &&
+               stream->overflowPolicy == SoapySDRPlayStream::OVERFLOW_DROP_OLDEST)
+        {
+            // drop oldest: take the oldest buffer back, unless the reader
+            // holds it; its samples are accounted to the next buffer
+            size_t expected = head;
+            if (!stream->acquired.compare_exchange_strong(expected, ACQUIRED_LOCKED))
+            {
+                break;
+            }
+            const auto &oldest = stream->buffsInfo[head % numBuffers];
+            if (head + 1 == tail && fill == 0)
+            {
+                // the next buffer has not been started yet
+                stream->pendingLost += oldest.lost + oldest.length;
+                stream->pendingUsbLost += oldest.usbLost;
+            }
+            else
+            {
+                auto &next = stream->buffsInfo[(head + 1) % numBuffers];
+                next.lost += oldest.lost + oldest.length;
+                next.usbLost += oldest.usbLost;
+                next.flags |= next.usbLost != 0 ? SDRPLAY_USB_LOSS_FLAG : 0;
+            }
+            statsAdd(stream->stats.samplesDropped, oldest.length);
+            stream->head.store(head + 1);
+            stream->acquired.store(head + 1);
+            head++;
+        }
+        numElems = std::min(ringSamples, (numBuffers - (tail - head)) * bufferElems - fill);
+
+        // the first sample in a buffer gives the buffer its timestamp
+        // and carries the number of samples lost right before it
+        for (size_t offset = 0; offset < numElems; offset += bufferElems - (fill + offset) % bufferElems)
+        {
+            if ((fill + offset) % bufferElems == 0)
+            {
+                auto &info = stream->buffsInfo[(tail + (fill + offset) / bufferElems) % numBuffers];
+                info.flags = (hasTime ? SOAPY_SDR_HAS_TIME : 0) | bufferFormatFlags() |
+                             (stream->pendingUsbLost != 0 ? SDRPLAY_USB_LOSS_FLAG : 0);
+                info.timeNs = hasTime ? bufferTimeNs((unsigned int)(numDirect + offset)) + timeOffset : 0;
+                info.lost = stream->pendingLost;
+                info.usbLost = stream->pendingUsbLost;
+                info.frequency = stream->frequency;
+                stream->pendingLost = 0;
+                stream->pendingUsbLost = 0;
+            }
+        }
+
+        // no room for the rest of this callback: drop it
+        if (numElems < ringSamples)
+        {
+            stream->pendingLost += ringSamples - numElems;
+            statsAdd(stream->stats.samplesDropped, ringSamples - numElems);
+            if (stream->overflowPolicy == SoapySDRPlayStream::OVERFLOW_FLUSH)
+            {
+                stream->overflowEvent = true;
+            }
+        }
+
+        // the other channel has to follow the same way
+        stream->pairValid = true;
+        stream->pairSampleNum = params->firstSampleNum;
+        stream->pairNumSamples = receivedSamples;
+        stream->pairDirect = numDirect;
+        stream->pairElems = numElems;
+        stream->pairBufferElems = bufferElems;
+        stream->pairSkip = skipped;
+        stream->pairBurstEnd = burstEnd;
+    }
+    else
+    {
+        // tuner B must deliver the same samples tuner A just did
+        if (!stream->pairValid)
+        {
+            return;
+        }
+        stream->pairValid = false;
+        if (params->firstSampleNum != stream->pairSampleNum || numSamples != stream->pairNumSamples)
+        {
+            SoapySDR_log(SOAPY_SDR_WARNING, "RSPduo tuner callbacks out of step - resetting stream");
+            stream->reset = true;
+            return;
+        }
+        xi += stream->pairSkip;
+        xq += stream->pairSkip;
+        numSamples -= stream->pairSkip;
+        if (stream->resampleDesign)
+        {
+            numSamples = stream->resamplers[1].process(xi, xq, numSamples);
+            xi = stream->resamplers[1].outI();
+            xq = stream->resamplers[1].outQ();
+        }
+        if (stream->ncos[1].step != 0 && !fusedFrequencyShift(stream))
+        {
+            shiftFrequency(converters, stream, 1, xi, xq, numSamples);
+        }
+        numDirect = stream->pairDirect;
+        numElems = stream->pairElems;
+        bufferElems = stream->pairBufferElems;
+        burstEnd = stream->pairBurstEnd;
     }
 
-    // get current fill buffer
-    auto &buff = stream->buffs[stream->tail];
+    SoapySDRPlayNco *nco = stream->ncos[chan].step != 0 && fusedFrequencyShift(stream) ? &stream->ncos[chan] : nullptr;
 
-    // we do not reallocate here, as we only resize within
-    // the buffers capacity
-    buff.resize(buff.size() + spaceReqd);
+    // tuner A let go of the buffers lent by the reader after writing its
+    // channel, so that they are never WRITING in between two callbacks;
+    // if the reader took them back since, the samples tuner A put in them
+    // are lost (to the ring buffer started next)
+    unsigned int offset = 0;
+    if (stream->directActive && !firstChannel)
+    {
+        int expected = SoapySDRPlayStream::DIRECT_CLAIMED;
+        if (!stream->directState.compare_exchange_strong(expected, SoapySDRPlayStream::DIRECT_WRITING))
+        {
+            stream->directActive = false;
+            stream->fill = 0;
+            if (numElems != 0)
+            {
+                stream->buffsInfo[stream->tail.load(std::memory_order_relaxed) % numBuffers].lost += numDirect;
+            }
+            else
+            {
+                stream->pendingLost += numDirect;
+            }
+            statsAdd(stream->stats.samplesDropped, numDirect);
+            offset = (unsigned int)numDirect;
+        }
+    }
 
-    // copy into the buffer queue
-    unsigned int i = 0;
+    // convert into the buffers lent by the reader
+    if (stream->directActive)
+    {
+        char *buff = (char *)stream->directBuffs[chan] + stream->fill * bytesPerSample;
+        convertSamples(converters, stream->format, stream->directInfo.flags, xi, xq, buff, (unsigned int)numDirect, nco);
+        offset = (unsigned int)numDirect;
 
-    if (useShort)
+        if (lastChannel)
+        {
+            stream->fill += numDirect;
+            stream->directInfo.length = stream->fill;
+            // the burst ends in these buffers
+            if (burstEnd && numElems == 0)
+            {
+                stream->directInfo.flags |= SOAPY_SDR_END_BURST;
+            }
+            if (stream->fill >= stream->directLimit || (burstEnd && numElems == 0))
+            {
+                // hand them back to the reader
+                stream->directActive = false;
+                stream->fill = 0;
+                stream->directState = SoapySDRPlayStream::DIRECT_DONE;
+            }
+            else
+            {
+                stream->directState = SoapySDRPlayStream::DIRECT_CLAIMED;
+            }
+        }
+        else
+        {
+            stream->directState = SoapySDRPlayStream::DIRECT_CLAIMED;
+        }
+        // the reader may be waiting for them, or to take them back
+        if (stream->readerWaiting)
+        {
+            std::lock_guard<std::mutex> lock(stream->mutex);
+            stream->cond.notify_one();
+        }
+    }
+
+    // convert into the buffers from tail on
+    size_t tail = stream->tail.load(std::memory_order_relaxed);
+    size_t fill = numDirect != 0 ? 0 : stream->fill;
+    const size_t end = numDirect + numElems;
+    while (offset < end || fill >= bufferElems)
     {
-       short *dptr = buff.data();
-       dptr += (buff.size() - spaceReqd);
-       for (i = 0; i < numSamples; i++)
-       {
-           *dptr++ = xi[i];
-           *dptr++ = xq[i];
+        unsigned int n = (unsigned int)std::min(end - offset, bufferElems - std::min(fill, bufferElems));
+        char *buff = stream->buffs[tail % numBuffers] + chan * stream->channelStride + fill * ringBytesPerSample;
+        convertSamples(converters, stream->ringFormat, stream->buffsInfo[tail % numBuffers].flags, xi + offset, xq + offset, buff, n, nco);
+        fill += n;
+        offset += n;
+
+        if (fill >= bufferElems)
+        {
+            if (lastChannel)
+            {
+                // hand the filled buffer over to the reader
+                if (burstEnd && offset == end)
+                {
+                    stream->buffsInfo[tail % numBuffers].flags |= SOAPY_SDR_END_BURST;
+                }
+                stream->buffsInfo[tail % numBuffers].length = fill;
+                stream->tail = tail + 1;
+
+                // notify readStream() only if it is actually sleeping
+                if (stream->readerWaiting)
+                {
+                    std::lock_guard<std::mutex> lock(stream->mutex);
+                    stream->cond.notify_one();
+                }
+            }
+            fill = 0;
+            tail++;
         }
     }
-    else
+    // end of the burst: hand the last buffer over right away, and stop
+    // doing anything with the samples until activateStream()
+    if (lastChannel && burstEnd)
     {
-       float *dptr = (float *)buff.data();
-       dptr += ((buff.size() - spaceReqd) / shortsPerWord);
-       for (i = 0; i < numSamples; i++)
-       {
-          *dptr++ = (float)xi[i] / 32768.0f;
-          *dptr++ = (float)xq[i] / 32768.0f;
-       }
+        if (fill != 0 && !stream->directActive)
+        {
+            stream->buffsInfo[tail % numBuffers].flags |= SOAPY_SDR_END_BURST;
+            stream->buffsInfo[tail % numBuffers].length = fill;
+            stream->tail = tail + 1;
+            fill = 0;
+            tail++;
+            if (stream->readerWaiting)
+            {
+                std::lock_guard<std::mutex> lock(stream->mutex);
+                stream->cond.notify_one();
+            }
+        }
+        stream->paused = true;
+    }
+    if (lastChannel && !stream->directActive)
+    {
+        stream->fill = fill;
+    }
+    // keep the oscillator in step over the samples dropped
+    if (nco && end < numSamples)
+    {
+        nco->advance(numSamples - (unsigned int)end);
+    }
+    if (lastChannel)
+    {
+        statsMax(stream->stats.queueDepthMax, tail - stream->head.load(std::memory_order_relaxed));
     }
 
     return;
@@ -203,30 +1109,234 @@ void SoapySDRPlay::ev_callback(sdrplay_api_EventT eventId, sdrplay_api_TunerSele
     }
 }
 
+/*******************************************************************
+ * Stream buffers memory
+ ******************************************************************/
+
+static size_t getPageSize()
+{
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    return systemInfo.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// allocate a page aligned, zero filled memory area;
+// size may be rounded up when huge pages are used
+static void *allocateArena(size_t &size, bool useHugePages)
+{
+    void *arena = nullptr;
+#ifdef _WIN32
+    // large pages on Windows require a special privilege - stay with
+    // regular pages
+    arena = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+#if defined(MAP_HUGETLB)
+    if (useHugePages)
+    {
+        const size_t hugePageSize = 2 * 1024 * 1024;
+        size_t hugeSize = (size + hugePageSize - 1) / hugePageSize * hugePageSize;
+        arena = mmap(NULL, hugeSize, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (arena != MAP_FAILED)
+        {
+            size = hugeSize;
+            return arena;
+        }
+        SoapySDR_log(SOAPY_SDR_WARNING, "huge pages not available - using transparent huge pages or regular pages");
+    }
+#endif
+    arena = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (arena == MAP_FAILED)
+    {
+        return nullptr;
+    }
+#if defined(MADV_HUGEPAGE)
+    if (useHugePages)
+    {
+        madvise(arena, size, MADV_HUGEPAGE);
+    }
+#endif
+#endif
+    return arena;
+}
+
+static void freeArena(void *arena, size_t size)
+{
+#ifdef _WIN32
+    VirtualFree(arena, 0, MEM_RELEASE);
+#else
+    munmap(arena, size);
+#endif
+}
+
+static bool lockArena(void *arena, size_t size)
+{
+#ifdef _WIN32
+    return VirtualLock(arena, size) != 0;
+#else
+    return mlock(arena, size) == 0;
+#endif
+}
+
 /*******************************************************************
  * Stream API
  ******************************************************************/
 
 SoapySDRPlay::SoapySDRPlayStream::SoapySDRPlayStream(size_t channel,
+                                                     size_t numChannels,
                                                      size_t numBuffers,
-                                                     unsigned long bufferLength)
+                                                     unsigned long bufferSize,
+                                                     size_t bufferElems,
+                                                     bool scaleWithDecimation,
+                                                     bool useHugePages,
+                                                     bool lockMemory)
 {
-    std::lock_guard<std::mutex> lock(mutex);
-
     this->channel = channel;
+    this->numChannels = numChannels;
+    this->bufferElems = bufferElems;
+    this->scaleWithDecimation = scaleWithDecimation;
+    format = FORMAT_CS16;
+    bytesPerSample = 2 * sizeof(short);
+    cs8Shift = 8;
+    ringFormat = FORMAT_CS16;
+    ringBytesPerSample = 2 * sizeof(short);
 
     // clear async fifo counts
     tail = 0;
     head = 0;
-    count = 0;
+    acquired = 0;
+    fill = 0;
+    overflowPolicy = OVERFLOW_DROP_NEWEST;
+    pendingLost = 0;
+    pendingUsbLost = 0;
+    flushedLost = 0;
+    stats.callbacks = 0;
+    stats.samplesReceived = 0;
+    stats.callbackNs = 0;
+    stats.callbackNsMin = 0;
+    stats.callbackNsMax = 0;
+    stats.queueDepthMax = 0;
+    stats.usbGaps = 0;
+    stats.usbLostSamples = 0;
+    stats.samplesDropped = 0;
+    stats.samplesDelivered = 0;
+    stats.overflows = 0;
+    stats.resets = 0;
+    stats.samplesFlushed = 0;
+    statsBase = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    statsResetPending = false;
+    pairValid = false;
+    pairSampleNum = 0;
+    pairNumSamples = 0;
+    pairDirect = 0;
+    pairElems = 0;
+    pairBufferElems = 0;
+    pairSkip = 0;
+    pairBurstEnd = false;
+    zeroCopy = false;
+    directState = DIRECT_IDLE;
+    directBuffs[0] = nullptr;
+    directBuffs[1] = nullptr;
+    directElems = 0;
+    directInfo = { 0, 0, 0, 0, 0, 0 };
+    directActive = false;
+    directLimit = 0;
+    frequency = 0;
+    readFrequency = 0;
+    sweepDwellUs = 0;
+    sampleCountValid = false;
+    counterRestart = false;
+    lastSampleNum = 0;
+    lastNumSamples = 0;
+    decimation = 0;
+    oldDecimation = 0;
+    sampleCount = 0;
+    baseSampleCount = 0;
+    baseTimeNs = 0;
+    counterRate = 0;
+    resampleGeneration = 0;
+    resampleRestart = true;
+    resampleTimeNs = 0;
+    resampleCount = 0;
+    for (auto &nco : ncos)
+    {
+        nco.phase = 0;
+        nco.step = 0;
+    }
+    readerWaiting = false;
+    overflowEvent = false;
+    nElems = 0;
+    reset = false;
+    paused = false;
+    wasPaused = false;
+    resumeFlush = false;
+    timedStart = false;
+    startTimeNs = 0;
+    burstRemaining = 0;
+
+    // allocate buffers as fixed slots in one contiguous arena; each channel
+    // in a slot is rounded up to a cache line and the arena to a page
+    const size_t cacheLineSize = 64;
+    const size_t pageSize = getPageSize();
+    size_t channelSize = (bufferSize + cacheLineSize - 1) / cacheLineSize * cacheLineSize;
+    channelStride = channelSize;
+    size_t slotSize = numChannels * channelSize;
+    arenaSize = (numBuffers * slotSize + pageSize - 1) / pageSize * pageSize;
+    arena = allocateArena(arenaSize, useHugePages);
+    if (arena == nullptr)
+    {
+        throw std::runtime_error("setupStream failed to allocate the stream buffers");
+    }
+
+    if (lockMemory)
+    {
+        if (!lockArena(arena, arenaSize))
+        {
+            SoapySDR_logf(SOAPY_SDR_WARNING, "unable to lock %lu bytes of stream buffers in memory", (unsigned long)arenaSize);
+        }
+    }
+    else
+    {
+        // touch every page now to avoid page faults while streaming
+        std::memset(arena, 0, arenaSize);
+    }
 
-    // allocate buffers
     buffs.resize(numBuffers);
-    for (auto &buff : buffs) buff.reserve(bufferLength);
+    BufferInfo emptyInfo = { 0, 0, 0, 0, 0, 0 };
+    buffsInfo.resize(numBuffers, emptyInfo);
+    for (size_t i = 0; i < numBuffers; ++i)
+    {
+        buffs[i] = (char *)arena + i * slotSize;
+    }
+    // a run of drained buffers is followed by at least one held buffer
+    drains.reserve(numBuffers);
 }
 
 SoapySDRPlay::SoapySDRPlayStream::~SoapySDRPlayStream()
 {
+    freeArena(arena, arenaSize);
+}
+
+// by default buffers get shorter as decimation goes up (in the API and
+// in software), so that latency stays about the same; an explicit buffer
+// length is used as is
+size_t SoapySDRPlay::SoapySDRPlayStream::effectiveBufferElems(unsigned int decimationFactor,
+                                                              const SoapySDRPlayResampler::Design *resampleDesign) const
+{
+    if (!scaleWithDecimation)
+    {
+        return bufferElems;
+    }
+    size_t elems = std::max(bufferElems / decimationFactor, (size_t)1);
+    if (resampleDesign)
+    {
+        elems = std::max((size_t)((unsigned long long)elems * resampleDesign->outputRate / resampleDesign->inputRate), (size_t)1);
+    }
+    return elems;
 }
 
 SoapySDR::Stream *SoapySDRPlay::setupStream(const int direction,
@@ -236,92 +1346,362 @@ SoapySDR::Stream *SoapySDRPlay::setupStream(const int direction,
 {
     size_t nchannels = device.hwVer == SDRPLAY_RSPduo_ID && device.rspDuoMode == sdrplay_api_RspDuoMode_Dual_Tuner ? 2 : 1;
 
-    // check the channel configuration
-    if (channels.size() > 1 or (channels.size() > 0 and channels.at(0) >= nchannels))
+    // check the channel configuration; in Dual Tuner mode both tuners
+    // can also be streamed together as channels {0, 1}
+    bool bothTuners = nchannels == 2 and channels.size() == 2 and channels.at(0) == 0 and channels.at(1) == 1;
+    if ((channels.size() > 1 and not bothTuners) or (channels.size() > 0 and channels.at(0) >= nchannels))
     {
        throw std::runtime_error("setupStream invalid channel selection");
     }
 
     // check the format
+    SoapySDRPlayStream::Format streamFormat;
+    size_t bytesPerSample;
+    int cs8Shift = 8;
     if (format == "CS16")
     {
-        useShort = true;
-        shortsPerWord = 1;
-        bufferLength = bufferElems * elementsPerSample * shortsPerWord;
+        streamFormat = SoapySDRPlayStream::FORMAT_CS16;
+        bytesPerSample = 2 * sizeof(short);
         SoapySDR_log(SOAPY_SDR_INFO, "Using format CS16.");
     }
     else if (format == "CF32")
     {
-        useShort = false;
-        shortsPerWord = sizeof(float) / sizeof(short);
-        bufferLength = bufferElems * elementsPerSample * shortsPerWord;  // allocate enough space for floats instead of shorts
+        streamFormat = SoapySDRPlayStream::FORMAT_CF32;
+        bytesPerSample = 2 * sizeof(float);
         SoapySDR_log(SOAPY_SDR_INFO, "Using format CF32.");
     }
+    else if (format == "CS12")
+    {
+        streamFormat = SoapySDRPlayStream::FORMAT_CS12;
+        bytesPerSample = 3;
+        SoapySDR_log(SOAPY_SDR_INFO, "Using format CS12.");
+    }
+    else if (format == "CS8")
+    {
+        streamFormat = SoapySDRPlayStream::FORMAT_CS8;
+        bytesPerSample = 2 * sizeof(signed char);
+        if (args.count("cs8shift") != 0)
+        {
+            const std::string &shift = args.at("cs8shift");
+            cs8Shift = shift == "auto" ? -1 : std::stoi(shift);
+            if (cs8Shift < -1 || cs8Shift > 8)
+            {
+                throw std::runtime_error("setupStream invalid CS8 shift '" + shift + "'");
+            }
+        }
+        if (cs8Shift < 0)
+        {
+            SoapySDR_log(SOAPY_SDR_INFO, "Using format CS8 (block floating point).");
+        }
+        else
+        {
+            SoapySDR_logf(SOAPY_SDR_INFO, "Using format CS8 (shift %d).", cs8Shift);
+        }
+    }
     else
     {
         throw std::runtime_error( "setupStream invalid format '" + format +
-                                  "' -- Only CS16 or CF32 are supported by the SoapySDRPlay module.");
+                                  "' -- Only CS8, CS12, CS16 or CF32 are supported by the SoapySDRPlay module.");
     }
 
     // default is channel 0
     size_t channel = channels.size() == 0 ? 0 : channels.at(0);
+    size_t numChannels = bothTuners ? 2 : 1;
     SoapySDRPlayStream *sdrplay_stream = _streams[channel];
+    if (sdrplay_stream != 0 and (sdrplay_stream->numChannels != numChannels or
+                                 (bothTuners and _streams[1] != sdrplay_stream)))
+    {
+        throw std::runtime_error("setupStream channel already in use by another stream");
+    }
+    if (bothTuners and _streams[1] != 0 and _streams[1] != sdrplay_stream)
+    {
+        throw std::runtime_error("setupStream channel already in use by another stream");
+    }
+    if (sdrplay_stream != 0 and (sdrplay_stream->format != streamFormat or sdrplay_stream->cs8Shift != cs8Shift))
+    {
+        throw std::runtime_error("setupStream channel already in use by a stream in another format");
+    }
     if (sdrplay_stream == 0)
     {
-        sdrplay_stream = new SoapySDRPlayStream(channel, numBuffers, bufferLength);
+        // buffer configuration
+        size_t numBuffers = DEFAULT_NUM_BUFFERS;
+        size_t bufferElems = DEFAULT_BUFFER_LENGTH;
+        bool scaleWithDecimation = true;
+        if (args.count("buffers") != 0)
+        {
+            numBuffers = std::stoul(args.at("buffers"));
+            if (numBuffers < 2)
+            {
+                throw std::runtime_error("setupStream invalid number of buffers - at least 2 buffers are required");
+            }
+        }
+        if (args.count("bufflen") != 0)
+        {
+            bufferElems = std::stoul(args.at("bufflen"));
+            scaleWithDecimation = false;
+        }
+        else if (args.count("latency") != 0)
+        {
+            // enough samples at the current sample rate to cover the latency target
+            double latencyUs = std::stod(args.at("latency"));
+            double sampleRate = getSampleRate(direction, channel);
+            bufferElems = (size_t)std::ceil(sampleRate * latencyUs / 1e6);
+            scaleWithDecimation = false;
+        }
+        if (bufferElems == 0)
+        {
+            throw std::runtime_error("setupStream invalid buffer length");
+        }
+        SoapySDR_logf(SOAPY_SDR_INFO, "Using %lu buffers of %lu samples.", (unsigned long)numBuffers, (unsigned long)bufferElems);
+        if (bothTuners)
+        {
+            SoapySDR_log(SOAPY_SDR_INFO, "Streaming both tuners in one stream.");
+        }
+
+        // the buffers hold CF32 for direct buffer access; with
+        // directaccess=false they hold CS16, converted by readStream()
+        bool directAccess = args.count("directaccess") == 0 || args.at("directaccess") != "false";
+        SoapySDRPlayStream::Format ringFormat = streamFormat;
+        size_t ringBytesPerSample = bytesPerSample;
+        if (streamFormat == SoapySDRPlayStream::FORMAT_CF32 && !directAccess)
+        {
+            ringFormat = SoapySDRPlayStream::FORMAT_CS16;
+            ringBytesPerSample = 2 * sizeof(short);
+        }
+
+        unsigned long bufferSize = bufferElems * ringBytesPerSample;
+        bool useHugePages = args.count("hugepages") != 0 && args.at("hugepages") == "true";
+        bool lockMemory = args.count("mlock") != 0 && args.at("mlock") == "true";
+
+        SoapySDRPlayStream::OverflowPolicy overflowPolicy = SoapySDRPlayStream::OVERFLOW_DROP_NEWEST;
+        if (args.count("overflow") != 0)
+        {
+            const std::string &policy = args.at("overflow");
+            if (policy == "drop_newest") overflowPolicy = SoapySDRPlayStream::OVERFLOW_DROP_NEWEST;
+            else if (policy == "drop_oldest") overflowPolicy = SoapySDRPlayStream::OVERFLOW_DROP_OLDEST;
+            else if (policy == "flush") overflowPolicy = SoapySDRPlayStream::OVERFLOW_FLUSH;
+            else throw std::runtime_error("setupStream invalid overflow policy '" + policy + "'");
+        }
+
+        bool resumeFlush = false;
+        if (args.count("resume") != 0)
+        {
+            const std::string &resume = args.at("resume");
+            if (resume == "flush") resumeFlush = true;
+            else if (resume != "keep") throw std::runtime_error("setupStream invalid resume option '" + resume + "'");
+        }
+
+        // frequency sweep: a list of RF frequencies and the time spent on each
+        std::vector<double> sweepFrequencies;
+        double sweepDwellUs = 10000;
+        if (args.count("sweep") != 0)
+        {
+            SoapySDR::RangeList frequencyRange = getFrequencyRange(direction, channel, "RF");
+            std::stringstream sweep(args.at("sweep"));
+            std::string frequency;
+            while (std::getline(sweep, frequency, ','))
+            {
+                double value = std::stod(frequency);
+                if (!(value >= frequencyRange.front().minimum() && value <= frequencyRange.back().maximum()))
+                {
+                    throw std::runtime_error("setupStream sweep frequency out of range - " + frequency);
+                }
+                sweepFrequencies.push_back(value);
+            }
+            if (bothTuners && !sweepFrequencies.empty())
+            {
+                throw std::runtime_error("setupStream frequency sweep is not supported with both tuners in one stream");
+            }
+        }
+        if (args.count("dwell") != 0)
+        {
+            sweepDwellUs = std::stod(args.at("dwell"));
+            if (sweepDwellUs < 0)
+            {
+                throw std::runtime_error("setupStream invalid dwell time");
+            }
+        }
+        if (!sweepFrequencies.empty())
+        {
+            SoapySDR_logf(SOAPY_SDR_INFO, "Sweeping %lu frequencies, %g us each.", (unsigned long)sweepFrequencies.size(), sweepDwellUs);
+        }
+
+        sdrplay_stream = new SoapySDRPlayStream(channel, numChannels, numBuffers, bufferSize,
+                                                bufferElems, scaleWithDecimation,
+                                                useHugePages, lockMemory);
+        sdrplay_stream->format = streamFormat;
+        sdrplay_stream->bytesPerSample = bytesPerSample;
+        sdrplay_stream->cs8Shift = cs8Shift;
+        sdrplay_stream->ringFormat = ringFormat;
+        sdrplay_stream->ringBytesPerSample = ringBytesPerSample;
+        sdrplay_stream->overflowPolicy = overflowPolicy;
+        sdrplay_stream->resumeFlush = resumeFlush;
+        sdrplay_stream->zeroCopy = args.count("zerocopy") != 0 && args.at("zerocopy") == "true";
+        sdrplay_stream->frequency = chParams->tunerParams.rfFreq.rfHz;
+        sdrplay_stream->sweepFrequencies = sweepFrequencies;
+        sdrplay_stream->sweepDwellUs = sweepDwellUs;
+    }
+    return reinterpret_cast<SoapySDR::Stream *>(sdrplay_stream);
+}
+
+void SoapySDRPlay::closeStream(SoapySDR::Stream *stream)
+{
+    SoapySDRPlayStream *sdrplay_stream = reinterpret_cast<SoapySDRPlayStream *>(stream);
+
+    // the sweep scheduler takes _general_state_mutex too
+    if (sweepStream == sdrplay_stream)
+    {
+        stopSweep();
+    }
+
+    std::unique_lock <std::mutex> lock(_general_state_mutex);
+
+    bool deleteStream = false;
+    int activeStreams = 0;
+    for (int i = 0; i < 2; ++i)
+    {
+        if (_streams[i] == sdrplay_stream)
+        {
+            _streamsRefCount[i]--;
+            if (_streamsRefCount[i] == 0)
+            {
+                _streams[i] = 0;
+                deleteStream = true;
+            }
+        }
+        activeStreams += _streamsRefCount[i];
+    }
+
+    if (activeStreams == 0)
+    {
+        clearTimedCommands();
+    }
+    if (activeStreams == 0 && streamActive)
+    {
+        if (standby)
+        {
+            // keep the tuner streaming, so that the next activateStream()
+            // does not have to wait for Init()
+            SoapySDR_log(SOAPY_SDR_DEBUG, "Keeping the tuner streaming in standby.");
+        }
+        else
+        {
+            // Uninit() may have to wait for the RSPduo slave: the other
+            // calls on this device must not wait for it too
+            startTeardown();
+        }
+    }
+
+    if (deleteStream)
+    {
+        // a callback may still be using the stream (the tuner keeps
+        // streaming until Uninit(), or for good in standby); the other
+        // calls on this device do not have to wait for it
+        lock.unlock();
+        waitForCallbacks();
+        // notify readStream()
+        sdrplay_stream->cond.notify_one();
+        delete sdrplay_stream;
+    }
+}
+
+// Uninit() (with _general_state_mutex held)
+void SoapySDRPlay::stopStreaming(void)
+{
+    while (true)
+    {
+        sdrplay_api_ErrT err;
+        err = sdrplay_api_Uninit(device.dev);
+        if (err != sdrplay_api_StopPending)
+        {
+            break;
+        }
+        SoapySDR_logf(SOAPY_SDR_WARNING, "Please close RSPduo slave device first. Trying again in %d seconds", uninitRetryDelay);
+        std::this_thread::sleep_for(std::chrono::seconds(uninitRetryDelay));
+    }
+    streamActive = false;
+    clearTimedCommands();
+}
+
+// Uninit() in the background (with _general_state_mutex held)
+void SoapySDRPlay::startTeardown(void)
+{
+    // checked before teardown_thread_mutex is taken: a cancelTeardown()
+    // holding it may be waiting for the pending teardown, which needs
+    // _general_state_mutex to call Uninit()
+    if (teardownState == TEARDOWN_PENDING)
+    {
+        return;
+    }
+    std::lock_guard <std::mutex> lock(teardown_thread_mutex);
+    // a previous teardown has finished: nothing left to wait for
+    if (teardownThread.joinable())
+    {
+        teardownThread.join();
+    }
+    teardownCancel = false;
+    teardownState = TEARDOWN_PENDING;
+    teardownThread = std::thread(&SoapySDRPlay::teardownLoop, this);
+}
+
+// stop retrying Uninit(); when this returns, either the tuner has been
+// stopped (streamActive is false) or it is still streaming
+void SoapySDRPlay::cancelTeardown(void)
+{
+    std::lock_guard <std::mutex> threadLock(teardown_thread_mutex);
+    if (!teardownThread.joinable())
+    {
+        return;
+    }
+    {
+        std::lock_guard <std::mutex> lock(teardown_mutex);
+        teardownCancel = true;
+        teardown_cond.notify_all();
     }
-    return reinterpret_cast<SoapySDR::Stream *>(sdrplay_stream);
+    teardownThread.join();
 }
 
-void SoapySDRPlay::closeStream(SoapySDR::Stream *stream)
+void SoapySDRPlay::teardownLoop(void)
 {
-    std::lock_guard <std::mutex> lock(_general_state_mutex);
-
-    SoapySDRPlayStream *sdrplay_stream = reinterpret_cast<SoapySDRPlayStream *>(stream);
-
-    bool deleteStream = false;
-    int activeStreams = 0;
-    for (int i = 0; i < 2; ++i)
+    while (true)
     {
-        if (_streams[i] == sdrplay_stream)
+        sdrplay_api_ErrT err;
         {
-            _streamsRefCount[i]--;
-            if (_streamsRefCount[i] == 0)
+            std::lock_guard <std::mutex> lock(_general_state_mutex);
+            err = sdrplay_api_Uninit(device.dev);
+            if (err != sdrplay_api_StopPending)
             {
-                _streams[i] = 0;
-                deleteStream = true;
+                streamActive = false;
+                clearTimedCommands();
             }
         }
-        activeStreams += _streamsRefCount[i];
-    }
-
-    if (deleteStream)
-    {
-        // notify readStream()
-        sdrplay_stream->cond.notify_one();
-        delete sdrplay_stream;
-    }
-    if (activeStreams == 0)
-    {
-        while (true)
+        if (err != sdrplay_api_StopPending)
         {
-            sdrplay_api_ErrT err;
-            err = sdrplay_api_Uninit(device.dev);
-            if (err != sdrplay_api_StopPending)
+            if (err != sdrplay_api_Success)
             {
-                break;
+                SoapySDR_logf(SOAPY_SDR_ERROR, "error in closeStream() - Uninit() failed: %s", sdrplay_api_GetErrorString(err));
             }
-            SoapySDR_logf(SOAPY_SDR_WARNING, "Please close RSPduo slave device first. Trying again in %d seconds", uninitRetryDelay);
-            std::this_thread::sleep_for(std::chrono::seconds(uninitRetryDelay));
+            teardownState = err == sdrplay_api_Success ? TEARDOWN_DONE : TEARDOWN_FAILED;
+            return;
+        }
+        SoapySDR_logf(SOAPY_SDR_WARNING, "Please close RSPduo slave device first. Trying again in %d seconds", uninitRetryDelay);
+        std::unique_lock <std::mutex> lock(teardown_mutex);
+        if (teardown_cond.wait_for(lock, std::chrono::seconds(uninitRetryDelay), [this]{ return teardownCancel; }))
+        {
+            teardownState = TEARDOWN_CANCELLED;
+            return;
         }
-        streamActive = false;
     }
 }
 
 size_t SoapySDRPlay::getStreamMTU(SoapySDR::Stream *stream) const
 {
-    // is a constant in practice
-    return bufferElems;
+    SoapySDRPlayStream *sdrplay_stream = reinterpret_cast<SoapySDRPlayStream *>(stream);
+
+    // the buffer length at the current decimation and resampling (a later
+    // sample rate change makes the buffers shorter or longer)
+    std::lock_guard<std::mutex> lock(resampler_mutex);
+    return sdrplay_stream->effectiveBufferElems(chParams->ctrlParams.decimation.decimationFactor, resamplerDesign.get());
 }
 
 int SoapySDRPlay::activateStream(SoapySDR::Stream *stream,
@@ -329,27 +1709,107 @@ int SoapySDRPlay::activateStream(SoapySDR::Stream *stream,
                                  const long long timeNs,
                                  const size_t numElems)
 {
-    if (flags != 0)
+    if ((flags & ~(SOAPY_SDR_HAS_TIME | SOAPY_SDR_END_BURST)) != 0)
     {
-        SoapySDR_log(SOAPY_SDR_ERROR, "error in activateStream() - flags != 0");
+        SoapySDR_log(SOAPY_SDR_ERROR, "error in activateStream() - only SOAPY_SDR_HAS_TIME and SOAPY_SDR_END_BURST are supported");
         return SOAPY_SDR_NOT_SUPPORTED;
     }
 
     SoapySDRPlayStream *sdrplay_stream = reinterpret_cast<SoapySDRPlayStream *>(stream);
 
-    sdrplay_stream->reset = true;
-    sdrplay_stream->nElems = 0;
-    _streams[sdrplay_stream->channel] = sdrplay_stream;
-    _streamsRefCount[sdrplay_stream->channel]++;
+    // timed activation (from the sample at timeNs in the readStream()
+    // time base) and bursts of numElems samples; an attached stream is
+    // paused first, and the callbacks that may have got past the paused
+    // check before are waited for, so that rx_callback does not see them
+    // half set up (they are published by clearing paused); a timed or
+    // burst activation marks the stream as resumed even if no callback ran
+    // since it was paused, so that the buffer filled before the pause is
+    // handed over as is
+    const bool timed = (flags & SOAPY_SDR_HAS_TIME) != 0;
+    const size_t burstElems = (flags & SOAPY_SDR_END_BURST) != 0 ? numElems : 0;
+    const bool attached = _streams[sdrplay_stream->channel] == sdrplay_stream;
+    if (attached && (timed || burstElems != 0 || sdrplay_stream->paused))
+    {
+        sdrplay_stream->paused = true;
+        waitForCallbacks();
+        if (timed || burstElems != 0)
+        {
+            sdrplay_stream->wasPaused = true;
+        }
+    }
+    if (!attached || sdrplay_stream->paused)
+    {
+        sdrplay_stream->timedStart = timed;
+        sdrplay_stream->startTimeNs = timeNs;
+        sdrplay_stream->burstRemaining = burstElems;
+    }
+
+    // resume a stream paused by deactivateStream() or at the end of a
+    // burst: the tuner never stopped, so there is nothing else to do
+    if (sdrplay_stream->paused)
+    {
+        if (sdrplay_stream->resumeFlush)
+        {
+            sdrplay_stream->reset = true;
+        }
+        sdrplay_stream->paused.store(false, std::memory_order_release);
+        startSweep(sdrplay_stream);
+        return 0;
+    }
+
+    // a teardown still waiting for the RSPduo slave is cancelled, and the
+    // tuner it could not stop is used as in standby
+    cancelTeardown();
+
+    std::lock_guard <std::mutex> lock(_general_state_mutex);
+
+    // a reset would drop the samples until the reader drains the fifo,
+    // whereas a timed start has to catch its first sample
+    if (!timed)
+    {
+        sdrplay_stream->reset = true;
+    }
+    // the tuner is in standby, streaming already: its sample counter does
+    // not start over, so the timestamps start from the first callback
+    if (streamActive && _streamsRefCount[0] == 0 && _streamsRefCount[1] == 0)
+    {
+        sdrplay_stream->counterRestart = true;
+    }
+    for (size_t i = 0; i < sdrplay_stream->numChannels; ++i)
+    {
+        _streams[sdrplay_stream->channel + i] = sdrplay_stream;
+        _streamsRefCount[sdrplay_stream->channel + i]++;
+    }
 
     if (streamActive)
     {
+        startSweep(sdrplay_stream);
         return 0;
     }
 
     sdrplay_api_ErrT err;
 
-    std::lock_guard <std::mutex> lock(_general_state_mutex);
+    // the hardware sample counter starts over with Init()
+    for (int i = 0; i < 2; ++i)
+    {
+        SoapySDRPlayStream *activeStream = _streams[i];
+        if (activeStream)
+        {
+            activeStream->sampleCountValid = false;
+            activeStream->baseSampleCount = 0;
+            activeStream->baseTimeNs = 0;
+            activeStream->counterRate = 0;
+        }
+    }
+    try
+    {
+        outputSampleRate = getSampleRate(SOAPY_SDR_RX, sdrplay_stream->channel);
+    }
+    catch (const std::exception &)
+    {
+        // no timestamps without a valid sample rate
+        outputSampleRate = 0;
+    }
 
     // Enable (= sdrplay_api_DbgLvl_Verbose) API calls tracing,
     // but only for debug purposes due to its performance impact.
@@ -378,6 +1838,7 @@ int SoapySDRPlay::activateStream(SoapySDR::Stream *stream,
     }
 
     streamActive = true;
+    startSweep(sdrplay_stream);
 
     return 0;
 }
@@ -389,7 +1850,19 @@ int SoapySDRPlay::deactivateStream(SoapySDR::Stream *stream, const int flags, co
         return SOAPY_SDR_NOT_SUPPORTED;
     }
 
-    // do nothing because deactivateStream() can be called multiple times
+    // pause: rx_callback drops the samples until activateStream(), without
+    // stopping the tuner; deactivateStream() can be called multiple times,
+    // and on a stream that was never activated it does nothing
+    SoapySDRPlayStream *sdrplay_stream = reinterpret_cast<SoapySDRPlayStream *>(stream);
+    if (_streams[sdrplay_stream->channel] != sdrplay_stream || sdrplay_stream->paused)
+    {
+        return 0;
+    }
+    if (sweepStream == sdrplay_stream)
+    {
+        stopSweep();
+    }
+    sdrplay_stream->paused = true;
     return 0;
 }
 
@@ -421,10 +1894,29 @@ int SoapySDRPlay::readStream(SoapySDR::Stream *stream,
     // fv
     std::lock_guard <std::mutex> lock(sdrplay_stream->anotherMutex);
 
+    // a reset drops what is left of the buffer being read too
+    if (sdrplay_stream->reset && sdrplay_stream->nElems != 0)
+    {
+        this->releaseReadBuffer(stream, sdrplay_stream->currentHandle);
+        sdrplay_stream->nElems = 0;
+    }
+
+    // zero copy: with nothing queued, rx_callback converts the next
+    // buffer straight into the caller's buffers
+    if (sdrplay_stream->zeroCopy && sdrplay_stream->nElems == 0)
+    {
+        int ret = this->readStreamDirect(sdrplay_stream, buffs, numElems, flags, timeNs, timeoutUs);
+        if (ret != 0)
+        {
+            return ret;
+        }
+    }
+
     // are elements left in the buffer? if not, do a new read.
     if (sdrplay_stream->nElems == 0)
     {
-        int ret = this->acquireReadBuffer(stream, sdrplay_stream->currentHandle, (const void **)&sdrplay_stream->currentBuff, flags, timeNs, timeoutUs);
+        const void *currentBuffs[2];
+        int ret = this->acquireRingBuffer(sdrplay_stream, sdrplay_stream->currentHandle, currentBuffs, flags, timeNs, timeoutUs);
 
         if (ret < 0)
         {
@@ -433,34 +1925,43 @@ int SoapySDRPlay::readStream(SoapySDR::Stream *stream,
             return ret;
         }
         sdrplay_stream->nElems = ret;
+        sdrplay_stream->currentBuff = (char *)currentBuffs[0];
     }
 
-    size_t returnedElems = std::min(sdrplay_stream->nElems.load(), numElems);
-
-    // copy into user's buff - always write to buffs[0] since each stream
-    // can have only one rx/channel
-    if (useShort)
+    // the time of the first sample returned by this call is the
+    // buffer time plus the samples already read from that buffer
+    const SoapySDRPlayStream::BufferInfo &info = sdrplay_stream->buffsInfo[sdrplay_stream->currentHandle];
+    flags = info.flags;
+    timeNs = info.timeNs;
+    if ((flags & SOAPY_SDR_HAS_TIME) && outputSampleRate > 0)
     {
-        std::memcpy(buffs[0], sdrplay_stream->currentBuff, returnedElems * 2 * sizeof(short));
+        timeNs += SoapySDR::ticksToTimeNs(info.length - sdrplay_stream->nElems, outputSampleRate);
     }
-    else
+    // the gap is right before the first sample of the buffer
+    if (sdrplay_stream->nElems != info.length)
     {
-        std::memcpy(buffs[0], (float *)(void*)sdrplay_stream->currentBuff, returnedElems * 2 * sizeof(float));
+        flags &= ~SDRPLAY_USB_LOSS_FLAG;
     }
 
-    // bump variables for next call into readStream
-    sdrplay_stream->nElems -= returnedElems;
+    size_t returnedElems = std::min(sdrplay_stream->nElems.load(), numElems);
 
-    // scope lock here to update stream->currentBuff position
+    // copy (or convert) into user's buffs - one per channel
+    for (size_t i = 0; i < sdrplay_stream->numChannels; ++i)
     {
-        std::lock_guard <std::mutex> lock(sdrplay_stream->mutex);
-        sdrplay_stream->currentBuff += returnedElems * elementsPerSample * shortsPerWord;
+        const char *currentBuff = sdrplay_stream->currentBuff + i * sdrplay_stream->channelStride;
+        copyFromRing(converters, sdrplay_stream, currentBuff, buffs[i], returnedElems);
     }
 
+    // bump variables for next call into readStream
+    sdrplay_stream->nElems -= returnedElems;
+    sdrplay_stream->currentBuff += returnedElems * sdrplay_stream->ringBytesPerSample;
+
     // return number of elements written to buff
     if (sdrplay_stream->nElems != 0)
     {
+        // the burst ends with the last sample of the buffer
         flags |= SOAPY_SDR_MORE_FRAGMENTS;
+        flags &= ~SOAPY_SDR_END_BURST;
     }
     else
     {
@@ -476,16 +1977,24 @@ int SoapySDRPlay::readStream(SoapySDR::Stream *stream,
 size_t SoapySDRPlay::getNumDirectAccessBuffers(SoapySDR::Stream *stream)
 {
     SoapySDRPlayStream *sdrplay_stream = reinterpret_cast<SoapySDRPlayStream *>(stream);
-    std::lock_guard <std::mutex> lockA(sdrplay_stream->mutex);
+    if (sdrplay_stream->ringFormat != sdrplay_stream->format)
+    {
+        return 0;
+    }
     return sdrplay_stream->buffs.size();
 }
 
 int SoapySDRPlay::getDirectAccessBufferAddrs(SoapySDR::Stream *stream, const size_t handle, void **buffs)
 {
     SoapySDRPlayStream *sdrplay_stream = reinterpret_cast<SoapySDRPlayStream *>(stream);
-    std::lock_guard <std::mutex> lockA(sdrplay_stream->mutex);
-    // always write to buffs[0] since each stream can have only one rx/channel
-    buffs[0] = (void *)sdrplay_stream->buffs[handle].data();
+    if (sdrplay_stream->ringFormat != sdrplay_stream->format)
+    {
+        return SOAPY_SDR_NOT_SUPPORTED;
+    }
+    for (size_t i = 0; i < sdrplay_stream->numChannels; ++i)
+    {
+        buffs[i] = (void *)(sdrplay_stream->buffs[handle] + i * sdrplay_stream->channelStride);
+    }
     return 0;
 }
 
@@ -497,37 +2006,110 @@ int SoapySDRPlay::acquireReadBuffer(SoapySDR::Stream *stream,
                                     const long timeoutUs)
 {
     SoapySDRPlayStream *sdrplay_stream = reinterpret_cast<SoapySDRPlayStream *>(stream);
+    // the buffers of a CF32 stream hold CS16 with directaccess=false
+    if (sdrplay_stream->ringFormat != sdrplay_stream->format)
+    {
+        return SOAPY_SDR_NOT_SUPPORTED;
+    }
+    return this->acquireRingBuffer(sdrplay_stream, handle, buffs, flags, timeNs, timeoutUs);
+}
 
-    std::unique_lock <std::mutex> lock(sdrplay_stream->mutex);
+int SoapySDRPlay::acquireRingBuffer(SoapySDRPlayStream *sdrplay_stream,
+                                    size_t &handle,
+                                    const void **buffs,
+                                    int &flags,
+                                    long long &timeNs,
+                                    const long timeoutUs)
+{
+    const size_t numBuffers = sdrplay_stream->buffs.size();
 
     // reset is issued by various settings
-    // overflow set in the rx callback thread
+    // overflow set in the rx callback thread (flush overflow policy)
     if (sdrplay_stream->reset || sdrplay_stream->overflowEvent)
     {
-        // drain all buffers from the fifo
-        sdrplay_stream->tail = 0;
-        sdrplay_stream->head = 0;
-        sdrplay_stream->count = 0;
-        for (auto &buff : sdrplay_stream->buffs) buff.clear();
+        // drain all the filled buffers from the fifo; the buffer
+        // rx_callback is currently filling is left alone
+        size_t tail = sdrplay_stream->tail.load(std::memory_order_acquire);
+        size_t acquired = sdrplay_stream->acquired.load();
+        while (acquired == ACQUIRED_LOCKED || !sdrplay_stream->acquired.compare_exchange_weak(acquired, tail))
+        {
+            if (acquired == ACQUIRED_LOCKED)
+            {
+                std::this_thread::yield();
+                acquired = sdrplay_stream->acquired.load();
+            }
+        }
+        size_t head = sdrplay_stream->head.load();
+        size_t drained = 0;
+        size_t drainedLost = 0;
+        for (size_t i = acquired; i != tail; ++i)
+        {
+            const auto &info = sdrplay_stream->buffsInfo[i % numBuffers];
+            drained += info.length;
+            drainedLost += info.lost;
+        }
+        if (head == acquired)
+        {
+            sdrplay_stream->head.store(tail, std::memory_order_release);
+        }
+        else if (tail != acquired)
+        {
+            // the reader still holds some buffers: those stay valid, and
+            // the drained ones are given back when the buffers before
+            // them are released
+            auto &drains = sdrplay_stream->drains;
+            if (!drains.empty() && drains.back().first + drains.back().second == acquired)
+            {
+                drains.back().second += tail - acquired;
+            }
+            else
+            {
+                drains.push_back(std::make_pair(acquired, tail - acquired));
+            }
+        }
         sdrplay_stream->overflowEvent = false;
         if (sdrplay_stream->reset)
         {
            sdrplay_stream->reset = false;
+           sdrplay_stream->flushedLost = 0;
+           statsAdd(sdrplay_stream->stats.resets, 1);
         }
         else
         {
-           SoapySDR_log(SOAPY_SDR_SSI, "O");
-           return SOAPY_SDR_OVERFLOW;
+           // reported together with the samples dropped by rx_callback
+           // right before the next buffer
+           sdrplay_stream->flushedLost += drainedLost + drained;
+           statsAdd(sdrplay_stream->stats.samplesFlushed, drained);
         }
     }
 
-    // wait for a buffer to become available
-    if (sdrplay_stream->count == 0)
+    // wait for a buffer to become available and take it
+    size_t acquired;
+    for (;;)
     {
-        sdrplay_stream->cond.wait_for(lock, std::chrono::microseconds(timeoutUs));
-        if (sdrplay_stream->count == 0)
+        acquired = sdrplay_stream->acquired.load();
+        if (acquired == ACQUIRED_LOCKED)
+        {
+            // rx_callback is taking back the oldest buffer
+            std::this_thread::yield();
+            continue;
+        }
+        if (acquired == sdrplay_stream->tail)
+        {
+            std::unique_lock <std::mutex> lock(sdrplay_stream->mutex);
+            sdrplay_stream->readerWaiting = true;
+            sdrplay_stream->cond.wait_for(lock, std::chrono::microseconds(timeoutUs),
+                [sdrplay_stream]{ return sdrplay_stream->acquired != sdrplay_stream->tail; });
+            sdrplay_stream->readerWaiting = false;
+            if (sdrplay_stream->acquired == sdrplay_stream->tail)
+            {
+               return SOAPY_SDR_TIMEOUT;
+            }
+            continue;
+        }
+        if (sdrplay_stream->acquired.compare_exchange_weak(acquired, acquired + 1))
         {
-           return SOAPY_SDR_TIMEOUT;
+            break;
         }
     }
 
@@ -538,21 +2120,366 @@ int SoapySDRPlay::acquireReadBuffer(SoapySDR::Stream *stream,
     }
 
     // extract handle and buffer
-    handle = sdrplay_stream->head;
-    // always write to buffs[0] since each stream can have only one rx/channel
-    buffs[0] = (void *)sdrplay_stream->buffs[handle].data();
-    flags = 0;
+    handle = acquired % numBuffers;
+    SoapySDRPlayStream::BufferInfo &info = sdrplay_stream->buffsInfo[handle];
+    flags = info.flags;
+    timeNs = info.timeNs;
+    sdrplay_stream->readFrequency = info.frequency;
+
+    // samples were lost right before this buffer: report the overflow
+    // (with the time of the first sample after the gap) and hand the
+    // buffer out with the next call
+    size_t lost = info.lost + sdrplay_stream->flushedLost;
+    if (lost != 0)
+    {
+        info.lost = 0;
+        sdrplay_stream->flushedLost = 0;
+        sdrplay_stream->acquired.store(acquired);
+        statsAdd(sdrplay_stream->stats.overflows, 1);
+        SoapySDR_log(SOAPY_SDR_SSI, "O");
+        SoapySDR_logf(SOAPY_SDR_DEBUG, "Overflow: %lu samples lost", (unsigned long)lost);
+        return SOAPY_SDR_OVERFLOW;
+    }
+
+    for (size_t i = 0; i < sdrplay_stream->numChannels; ++i)
+    {
+        buffs[i] = (void *)(sdrplay_stream->buffs[handle] + i * sdrplay_stream->channelStride);
+    }
 
-    sdrplay_stream->head = (sdrplay_stream->head + 1) % numBuffers;
+    if (info.usbLost != 0)
+    {
+        SoapySDR_logf(SOAPY_SDR_DEBUG, "USB gap: %lu samples lost", (unsigned long)info.usbLost);
+    }
+    statsAdd(sdrplay_stream->stats.samplesDelivered, info.length);
 
     // return number available
-    return (int)(sdrplay_stream->buffs[handle].size() / (elementsPerSample * shortsPerWord));
+    return (int)info.length;
 }
 
 void SoapySDRPlay::releaseReadBuffer(SoapySDR::Stream *stream, const size_t handle)
 {
     SoapySDRPlayStream *sdrplay_stream = reinterpret_cast<SoapySDRPlayStream *>(stream);
-    std::lock_guard <std::mutex> lockA(sdrplay_stream->mutex);
-    sdrplay_stream->buffs[handle].clear();
-    sdrplay_stream->count--;
+    // nothing to release: no buffer is held
+    size_t acquired = sdrplay_stream->acquired.load();
+    if (acquired == ACQUIRED_LOCKED || sdrplay_stream->head == acquired)
+    {
+        return;
+    }
+    // give the buffer back to rx_callback, and the buffers drained
+    // right after it by a reset or a flush
+    size_t head = sdrplay_stream->head.fetch_add(1, std::memory_order_release) + 1;
+    auto &drains = sdrplay_stream->drains;
+    if (!drains.empty() && head == drains.front().first)
+    {
+        sdrplay_stream->head.fetch_add(drains.front().second, std::memory_order_release);
+        drains.erase(drains.begin());
+    }
+}
+
+int SoapySDRPlay::readStreamDirect(SoapySDRPlayStream *stream,
+                                   void * const *buffs,
+                                   const size_t numElems,
+                                   int &flags,
+                                   long long &timeNs,
+                                   const long timeoutUs)
+{
+    // only when nothing is queued (or pending) in the ring; returning 0
+    // lets readStream() carry on with the ring
+    if (numElems == 0 || stream->reset || stream->overflowEvent ||
+        stream->flushedLost != 0 || stream->acquired != stream->tail)
+    {
+        return 0;
+    }
+
+    // lend the caller's buffers to rx_callback and wait
+    for (size_t i = 0; i < stream->numChannels; ++i)
+    {
+        stream->directBuffs[i] = buffs[i];
+    }
+    stream->directElems = numElems;
+    stream->directState = SoapySDRPlayStream::DIRECT_POSTED;
+    {
+        std::unique_lock <std::mutex> lock(stream->mutex);
+        stream->readerWaiting = true;
+        stream->cond.wait_for(lock, std::chrono::microseconds(timeoutUs),
+            [stream]{ return stream->directState == SoapySDRPlayStream::DIRECT_DONE ||
+                             stream->acquired != stream->tail; });
+        stream->readerWaiting = false;
+    }
+
+    // take them back; rx_callback may be writing into them right now,
+    // but it only does so within one conversion (a dual tuner stream has
+    // them CLAIMED in between the tuner A and B callbacks), and it wakes
+    // the reader up when it is done
+    int state = stream->directState;
+    for (;;)
+    {
+        if (state == SoapySDRPlayStream::DIRECT_WRITING)
+        {
+            std::unique_lock <std::mutex> lock(stream->mutex);
+            stream->readerWaiting = true;
+            stream->cond.wait(lock,
+                [stream]{ return stream->directState != SoapySDRPlayStream::DIRECT_WRITING; });
+            stream->readerWaiting = false;
+            state = stream->directState;
+            continue;
+        }
+        if (stream->directState.compare_exchange_weak(state, SoapySDRPlayStream::DIRECT_IDLE))
+        {
+            break;
+        }
+    }
+
+    if (state == SoapySDRPlayStream::DIRECT_POSTED)
+    {
+        // rx_callback did not use them: the ring got some data first
+        // (it had started a buffer already), or the timeout expired
+        return stream->acquired != stream->tail ? 0 : SOAPY_SDR_TIMEOUT;
+    }
+    if (stream->directInfo.length == 0)
+    {
+        // handed back empty by a reset
+        return 0;
+    }
+
+    // complete (DONE) or partially filled when the timeout expired (CLAIMED)
+    flags = stream->directInfo.flags;
+    timeNs = stream->directInfo.timeNs;
+    stream->readFrequency = stream->directInfo.frequency;
+    if (stream->directInfo.usbLost != 0)
+    {
+        SoapySDR_logf(SOAPY_SDR_DEBUG, "USB gap: %lu samples lost", (unsigned long)stream->directInfo.usbLost);
+    }
+    statsAdd(stream->stats.samplesDelivered, stream->directInfo.length);
+    return (int)stream->directInfo.length;
+}
+
+/*******************************************************************
+ * Frequency sweep
+ ******************************************************************/
+
+void SoapySDRPlay::startSweep(SoapySDRPlayStream *stream)
+{
+    if (stream->sweepFrequencies.empty() || sweepThread.joinable())
+    {
+        return;
+    }
+    sweepStream = stream;
+    sweepRunning = true;
+    sweepThread = std::thread(&SoapySDRPlay::sweepLoop, this, stream->sweepFrequencies, stream->sweepDwellUs);
+}
+
+void SoapySDRPlay::stopSweep()
+{
+    if (!sweepThread.joinable())
+    {
+        return;
+    }
+    {
+        std::lock_guard <std::mutex> lock(sweep_mutex);
+        sweepRunning = false;
+        sweep_cond.notify_all();
+    }
+    sweepThread.join();
+    sweepStream = nullptr;
+}
+
+// step through the frequencies, staying on each one for dwellUs after
+// rx_callback reports that the tuner has switched; _general_state_mutex
+// is only held while the update is issued, so the other settings are not
+// held up by the dwell
+void SoapySDRPlay::sweepLoop(const std::vector<double> frequencies, const double dwellUs)
+{
+    size_t step = 0;
+    std::unique_lock <std::mutex> lock(sweep_mutex);
+    while (sweepRunning)
+    {
+        const uint32_t frequency = (uint32_t)frequencies[step];
+        step = (step + 1) % frequencies.size();
+        lock.unlock();
+
+        bool updated = false;
+        {
+            std::lock_guard <std::mutex> stateLock(_general_state_mutex);
+            if (streamActive && chParams->tunerParams.rfFreq.rfHz != frequency)
+            {
+                chParams->tunerParams.rfFreq.rfHz = frequency;
+                rf_changed = 0;
+                sdrplay_api_ErrT err = sdrplay_api_Update(device.dev, device.tuner, sdrplay_api_Update_Tuner_Frf, sdrplay_api_Update_Ext1_None);
+                if (err != sdrplay_api_Success)
+                {
+                    SoapySDR_logf(SOAPY_SDR_WARNING, "sdrplay_api_Update(Tuner_FrF) Error: %s", sdrplay_api_GetErrorString(err));
+                }
+                else
+                {
+                    updated = true;
+                }
+            }
+        }
+        if (updated && !waitForChanged(rf_changed))
+        {
+            SoapySDR_log(SOAPY_SDR_WARNING, "RF center frequency update timeout.");
+        }
+
+        lock.lock();
+        sweep_cond.wait_for(lock, std::chrono::microseconds((long long)dwellUs),
+                            [this]{ return !sweepRunning; });
+    }
+}
+
+/*******************************************************************
+ * Time API
+ ******************************************************************/
+
+bool SoapySDRPlay::hasHardwareTime(const std::string &what) const
+{
+    return what.empty();
+}
+
+long long SoapySDRPlay::getHardwareTime(const std::string &what) const
+{
+    // time of the latest sample delivered by the hardware
+    return hardwareTimeNs + timeOffsetNs;
+}
+
+void SoapySDRPlay::setHardwareTime(const long long timeNs, const std::string &what)
+{
+    // the sample counter cannot be set, so keep an offset instead
+    timeOffsetNs = timeNs - hardwareTimeNs;
+}
+
+void SoapySDRPlay::setCommandTime(const long long timeNs, const std::string &what)
+{
+    // the following setFrequency() and setGain() calls are queued, to be
+    // made at this stream time (0 to make them right away again)
+    commandTimeNs = timeNs;
+}
+
+// queues a change for commandLoop(); false if it is due now (timeNs 0)
+// and the caller has to make it
+bool SoapySDRPlay::scheduleCommand(const long long timeNs, const int type, const std::string &name, const double value)
+{
+    if (timeNs == 0)
+    {
+        return false;
+    }
+
+    TimedCommand command;
+    command.timeNs = timeNs;
+    command.type = type;
+    command.name = name;
+    command.value = value;
+
+    std::lock_guard<std::mutex> lock(command_mutex);
+    // after the commands for the same time, so they are made in order
+    auto it = std::upper_bound(timedCommands.begin(), timedCommands.end(), timeNs,
+                               [](long long t, const TimedCommand &c) { return t < c.timeNs; });
+    timedCommands.insert(it, command);
+    nextCommandTimeNs = timedCommands.front().timeNs;
+    if (!commandThread.joinable())
+    {
+        commandRunning = true;
+        commandThread = std::thread(&SoapySDRPlay::commandLoop, this);
+    }
+    command_cond.notify_all();
+    return true;
+}
+
+// called by rx_callback with the time of its last sample: if a command
+// is due, tell commandLoop() (without locking or allocating anything)
+void SoapySDRPlay::signalTimedCommands(const long long timeNs)
+{
+    if (timeNs >= nextCommandTimeNs)
+    {
+        commandDueNs = timeNs;
+        nextCommandTimeNs = LLONG_MAX;
+        command_cond.notify_one();
+    }
+}
+
+void SoapySDRPlay::stopCommands(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(command_mutex);
+        if (!commandThread.joinable())
+        {
+            return;
+        }
+        commandRunning = false;
+        command_cond.notify_all();
+    }
+    commandThread.join();
+}
+
+// makes the commands rx_callback reports due; they are made with
+// _general_state_mutex held, like the setters would, and without waiting
+// for the updates to be reported, so that the next ones are on time too
+void SoapySDRPlay::commandLoop(void)
+{
+    std::unique_lock<std::mutex> lock(command_mutex);
+    while (commandRunning)
+    {
+        const long long dueNs = commandDueNs.exchange(LLONG_MIN);
+        if (dueNs == LLONG_MIN)
+        {
+            // rx_callback notifies without command_mutex, so a wakeup can
+            // be missed: look again every millisecond while commands wait
+            if (timedCommands.empty())
+            {
+                command_cond.wait(lock);
+            }
+            else
+            {
+                command_cond.wait_for(lock, std::chrono::milliseconds(1));
+            }
+            continue;
+        }
+
+        auto it = std::upper_bound(timedCommands.begin(), timedCommands.end(), dueNs,
+                                   [](long long t, const TimedCommand &c) { return t < c.timeNs; });
+        std::vector<TimedCommand> due(timedCommands.begin(), it);
+        timedCommands.erase(timedCommands.begin(), it);
+        nextCommandTimeNs = timedCommands.empty() ? LLONG_MAX : timedCommands.front().timeNs;
+        const unsigned int generation = commandGeneration;
+        lock.unlock();
+
+        {
+            std::lock_guard<std::mutex> stateLock(_general_state_mutex);
+            for (const auto &command : due)
+            {
+                if (generation != commandGeneration)
+                {
+                    break;
+                }
+                try
+                {
+                    if (command.type == TimedCommand::FREQUENCY)
+                    {
+                        applyFrequency(command.name, command.value, false);
+                    }
+                    else
+                    {
+                        applyGain(command.name, command.value, false);
+                    }
+                }
+                catch (const std::exception &ex)
+                {
+                    SoapySDR_logf(SOAPY_SDR_ERROR, "Timed command %s failed: %s", command.name.c_str(), ex.what());
+                }
+            }
+        }
+
+        lock.lock();
+    }
+}
+
+// drops the commands not made yet; the hardware time starts over with
+// the next Init(), so they would be made at the wrong time
+void SoapySDRPlay::clearTimedCommands(void)
+{
+    std::lock_guard<std::mutex> lock(command_mutex);
+    timedCommands.clear();
+    nextCommandTimeNs = LLONG_MAX;
+    commandDueNs = LLONG_MIN;
+    commandGeneration++;
 }
@@ -0,0 +1,288 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Charles J. Cliffe
+ * Copyright (c) 2020 Franco Venturi - changes for SDRplay API version 3
+ *                                     and Dual Tuner for RSPduo
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Control path benchmark: measures how long the settings calls take to
+// return while streaming (each of them waits until the update is reported
+// by the stream callbacks), the time from activateStream() to the first
+// sample, and how long closeStream() takes.
+// It runs the module against the mock sdrplay_api library, which reports
+// updates a number of callbacks after sdrplay_api_Update().
+//
+// Usage: SoapySDRPlayControlBenchmark [key=value ...]
+//  iterations=100     measurements per operation
+//  update_delay=1     callbacks between an update and its acknowledgement
+//  init_delay=0       ms between sdrplay_api_Init() and the first callback
+//  rate=0             mock sample rate in MS/s (0: the device configuration)
+//  size=1008          samples per callback
+//  output=csv         csv or json summary
+//  raw=0              1 to print every measurement (csv)
+
+#include "SoapySDRPlay.hpp"
+#include "sdrplay_api_mock.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedUs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+    std::sort(values.begin(), values.end());
+    size_t n = std::min((size_t)(p * values.size()), values.size() - 1);
+    return values[n];
+}
+
+// keeps the stream drained, as an application would
+class Reader
+{
+public:
+    Reader(SoapySDRPlay &device, SoapySDR::Stream *stream):
+        device(device), stream(stream), done(false), buff(2 * 65536)
+    {
+        thread = std::thread([this]
+        {
+            void *buffs[2] = { buff.data(), buff.data() };
+            int flags;
+            long long timeNs;
+            while (!done)
+            {
+                this->device.readStream(this->stream, buffs, 65536, flags, timeNs, 100000);
+            }
+        });
+    }
+
+    ~Reader(void)
+    {
+        done = true;
+        thread.join();
+    }
+
+private:
+    SoapySDRPlay &device;
+    SoapySDR::Stream *stream;
+    std::atomic_bool done;
+    std::vector<float> buff;
+    std::thread thread;
+};
+
+int main(int argc, char *argv[])
+{
+    unsigned int iterations = 100;
+    unsigned int updateDelay = 1;
+    double initDelayMs = 0;
+    double rateMsps = 0;
+    unsigned int numSamples = 1008;
+    std::string output = "csv";
+    bool raw = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        size_t eq = arg.find('=');
+        if (eq == std::string::npos)
+        {
+            fprintf(stderr, "invalid argument '%s' - key=value expected\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        std::string key = arg.substr(0, eq);
+        std::string value = arg.substr(eq + 1);
+        if (key == "iterations") iterations = (unsigned int)std::stoul(value);
+        else if (key == "update_delay") updateDelay = (unsigned int)std::stoul(value);
+        else if (key == "init_delay") initDelayMs = std::stod(value);
+        else if (key == "rate") rateMsps = std::stod(value);
+        else if (key == "size") numSamples = (unsigned int)std::stoul(value);
+        else if (key == "output") output = value;
+        else if (key == "raw") raw = value != "0";
+        else
+        {
+            fprintf(stderr, "unknown argument '%s'\n", key.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+    if (iterations == 0)
+    {
+        fprintf(stderr, "at least one iteration is required\n");
+        return EXIT_FAILURE;
+    }
+
+    SoapySDR_setLogLevel(SOAPY_SDR_WARNING);
+
+    SoapySDRPlay::sdrplay_api::get_instance();
+    sdrplay_api_mock_SetSampleRate(rateMsps > 0 ? rateMsps * 1e6 : -1);
+    sdrplay_api_mock_SetSamplesPerCallback(numSamples);
+    sdrplay_api_mock_SetUpdateDelay(updateDelay, 1);
+    sdrplay_api_mock_SetInitDelay(initDelayMs);
+    sdrplay_api_DeviceT devices[SDRPLAY_MAX_DEVICES];
+    unsigned int numDevices = 0;
+    sdrplay_api_GetDevices(devices, &numDevices, SDRPLAY_MAX_DEVICES);
+    if (numDevices == 0)
+    {
+        fprintf(stderr, "no mock device\n");
+        return EXIT_FAILURE;
+    }
+    SoapySDR::Kwargs deviceArgs;
+    deviceArgs["serial"] = devices[0].SerNo;
+    SoapySDRPlay device(deviceArgs);
+
+    // operation name -> latencies in us, in the order they are measured
+    std::vector<std::string> operations;
+    std::map<std::string, std::vector<double>> results;
+    auto measure = std::function<void(const std::string &, const std::function<void(unsigned int)> &)>(
+        [&](const std::string &name, const std::function<void(unsigned int)> &operation)
+    {
+        operations.push_back(name);
+        for (unsigned int i = 0; i < iterations; i++)
+        {
+            auto start = Clock::now();
+            operation(i);
+            results[name].push_back(elapsedUs(start));
+        }
+    });
+
+    // settings, while streaming
+    SoapySDR::Stream *stream = device.setupStream(SOAPY_SDR_RX, "CF32");
+    unsigned long long callbacks = sdrplay_api_mock_GetCallbackCount();
+    device.activateStream(stream);
+    while (sdrplay_api_mock_GetCallbackCount() == callbacks)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    {
+        Reader reader(device, stream);
+
+        measure("setFrequency", [&](unsigned int i)
+        {
+            device.setFrequency(SOAPY_SDR_RX, 0, i % 2 ? 100e6 : 101e6);
+        });
+        device.setGainMode(SOAPY_SDR_RX, 0, false);
+        measure("setGain", [&](unsigned int i)
+        {
+            device.setGain(SOAPY_SDR_RX, 0, "IFGR", i % 2 ? 30 : 40);
+        });
+        measure("setSampleRate", [&](unsigned int i)
+        {
+            device.setSampleRate(SOAPY_SDR_RX, 0, i % 2 ? 2e6 : 8e6);
+        });
+#ifdef RF_GAIN_IN_MENU
+        measure("writeSetting(rfgain_sel)", [&](unsigned int i)
+        {
+            device.writeSetting("rfgain_sel", i % 2 ? "1" : "2");
+        });
+#endif
+        measure("writeSetting(agc_setpoint)", [&](unsigned int i)
+        {
+            device.writeSetting("agc_setpoint", i % 2 ? "-30" : "-40");
+        });
+    }
+    device.closeStream(stream);
+
+    // start and stop; with one callback per buffer the first
+    // readStream() returns with the first callback
+    SoapySDR::Kwargs streamArgs;
+    streamArgs["bufflen"] = std::to_string(numSamples);
+    operations.push_back("activateStream+first sample");
+    operations.push_back("closeStream");
+    for (unsigned int i = 0; i < iterations; i++)
+    {
+        std::vector<float> buff(2 * 65536);
+        void *buffs[2] = { buff.data(), buff.data() };
+        int flags;
+        long long timeNs;
+        stream = device.setupStream(SOAPY_SDR_RX, "CF32", std::vector<size_t>(), streamArgs);
+        auto start = Clock::now();
+        device.activateStream(stream);
+        while (device.readStream(stream, buffs, 65536, flags, timeNs, 1000000) <= 0) {}
+        results["activateStream+first sample"].push_back(elapsedUs(start));
+
+        start = Clock::now();
+        device.closeStream(stream);
+        results["closeStream"].push_back(elapsedUs(start));
+    }
+
+    if (raw)
+    {
+        printf("operation,iteration,latency_us\n");
+        for (const auto &name : operations)
+        {
+            for (size_t i = 0; i < results[name].size(); i++)
+            {
+                printf("%s,%lu,%.1f\n", name.c_str(), (unsigned long)i, results[name][i]);
+            }
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (output == "json")
+    {
+        printf("{\n  \"update_delay_callbacks\": %u,\n  \"init_delay_ms\": %g,\n  \"samples_per_callback\": %u,\n  \"operations\": [\n",
+               updateDelay, initDelayMs, numSamples);
+    }
+    else
+    {
+        printf("operation,count,min_us,p50_us,p90_us,p99_us,max_us,mean_us\n");
+    }
+    for (size_t n = 0; n < operations.size(); n++)
+    {
+        const std::vector<double> &values = results[operations[n]];
+        double mean = 0;
+        for (double value : values)
+        {
+            mean += value / values.size();
+        }
+        double min = *std::min_element(values.begin(), values.end());
+        double max = *std::max_element(values.begin(), values.end());
+        if (output == "json")
+        {
+            printf("    { \"operation\": \"%s\", \"count\": %lu, \"min_us\": %.1f, \"p50_us\": %.1f, \"p90_us\": %.1f, "
+                   "\"p99_us\": %.1f, \"max_us\": %.1f, \"mean_us\": %.1f }%s\n",
+                   operations[n].c_str(), (unsigned long)values.size(), min, percentile(values, 0.5),
+                   percentile(values, 0.9), percentile(values, 0.99), max, mean,
+                   n + 1 < operations.size() ? "," : "");
+        }
+        else
+        {
+            printf("%s,%lu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n", operations[n].c_str(), (unsigned long)values.size(),
+                   min, percentile(values, 0.5), percentile(values, 0.9), percentile(values, 0.99), max, mean);
+        }
+    }
+    if (output == "json")
+    {
+        printf("  ]\n}\n");
+    }
+
+    return EXIT_SUCCESS;
+}
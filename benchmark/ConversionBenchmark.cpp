@@ -0,0 +1,271 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Charles J. Cliffe
+ * Copyright (c) 2020 Franco Venturi - changes for SDRplay API version 3
+ *                                     and Dual Tuner for RSPduo
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Micro-benchmark for the rx_callback interleave/convert kernels, the
+// software resampling filters and the software frequency shift.
+// Usage: SoapySDRPlayConversionBenchmark [numSamples] [iterations]
+
+#include "Conversion.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+template <typename Convert>
+static double benchmark(Convert convert, const short *xi, const short *xq,
+                        void *out, unsigned int numSamples, unsigned int iterations)
+{
+    // warm up the caches first
+    convert(xi, xq, out, numSamples);
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < iterations; i++)
+    {
+        convert(xi, xq, out, numSamples);
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+    return ns / ((double)numSamples * iterations);
+}
+
+static bool close(const std::vector<float> &reference, const std::vector<float> &out, unsigned int numSamples)
+{
+    for (unsigned int i = 0; i < 2 * numSamples; i++)
+    {
+        if (std::fabs(reference[i] - out[i]) > 1e-5f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the oscillators of the kernels round differently, so the shifted
+// samples only have to be within a couple of units of the scalar ones
+// (as do the ARMv7 conversions from float, which round ties differently)
+static bool closeCS16(const std::vector<short> &reference, const std::vector<short> &out, unsigned int numValues)
+{
+    for (unsigned int i = 0; i < numValues; i++)
+    {
+        if (std::abs(reference[i] - out[i]) > 2)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    // 1008 samples is the usual callback size at 2MHz in zero IF mode
+    unsigned int numSamples = argc > 1 ? (unsigned int)atoi(argv[1]) : 1008;
+    unsigned int iterations = argc > 2 ? (unsigned int)atoi(argv[2]) : 100000;
+
+    std::vector<short> xi(numSamples);
+    std::vector<short> xq(numSamples);
+    for (unsigned int i = 0; i < numSamples; i++)
+    {
+        xi[i] = (short)(rand() - RAND_MAX / 2);
+        xq[i] = (short)(rand() - RAND_MAX / 2);
+    }
+    std::vector<short> interleaved(2 * numSamples);
+    for (unsigned int i = 0; i < numSamples; i++)
+    {
+        interleaved[2 * i] = xi[i];
+        interleaved[2 * i + 1] = xq[i];
+    }
+
+    // complex float input and filter taps for the resampling filters
+    std::vector<float> samples(2 * (numSamples + 32));
+    for (auto &sample : samples)
+    {
+        sample = (float)(rand() - RAND_MAX / 2) / RAND_MAX;
+    }
+    std::vector<float> taps(2 * 32);
+    for (auto &tap : taps)
+    {
+        tap = (float)rand() / RAND_MAX / 32;
+    }
+
+    // (one more sample for the split of an odd number of samples)
+    std::vector<float> reference(2 * numSamples + 2);
+    std::vector<float> out(2 * numSamples + 2);
+    std::vector<short> referenceCS16(2 * numSamples);
+    std::vector<short> outCS16(2 * numSamples);
+
+    std::vector<SoapySDRPlayConverters> converters = SoapySDRPlay_listConverters();
+    printf("samples per call: %u - iterations: %u - selected kernels: %s\n",
+           numSamples, iterations, SoapySDRPlay_getConverters().name);
+    printf("%-8s %-6s %12s\n", "kernel", "format", "ns/sample");
+
+    int errors = 0;
+    for (const auto &converter : converters)
+    {
+        struct { const char *format; SoapySDRPlayConvertFn convert; SoapySDRPlayConvertFn scalar; size_t size; } formats[] = {
+            { "CS16", converter.toCS16, converters.front().toCS16, 2 * sizeof(short) },
+            { "CF32", converter.toCF32, converters.front().toCF32, 2 * sizeof(float) },
+            { "CS12", converter.toCS12, converters.front().toCS12, 3 },
+        };
+        for (const auto &format : formats)
+        {
+            // every kernel must produce exactly the same output as the scalar one
+            format.scalar(xi.data(), xq.data(), reference.data(), numSamples);
+            format.convert(xi.data(), xq.data(), out.data(), numSamples);
+            bool match = memcmp(reference.data(), out.data(), numSamples * format.size) == 0;
+            errors += match ? 0 : 1;
+
+            double nsPerSample = benchmark(format.convert, xi.data(), xq.data(), out.data(), numSamples, iterations);
+            printf("%-8s %-6s %12.3f%s\n", converter.name, format.format, nsPerSample, match ? "" : "  MISMATCH");
+        }
+
+        // CS8 at every shift, timed at the usual one
+        bool match = true;
+        for (unsigned int shift = 0; shift <= 8; shift++)
+        {
+            converters.front().toCS8(xi.data(), xq.data(), reference.data(), numSamples, shift);
+            converter.toCS8(xi.data(), xq.data(), out.data(), numSamples, shift);
+            match = match && memcmp(reference.data(), out.data(), numSamples * 2) == 0;
+        }
+        errors += match ? 0 : 1;
+        auto toCS8 = converter.toCS8;
+        double nsPerSample = benchmark([toCS8](const short *i, const short *q, void *o, unsigned int n) { toCS8(i, q, o, n, 8); },
+                                       xi.data(), xq.data(), out.data(), numSamples, iterations);
+        printf("%-8s %-6s %12.3f%s\n", converter.name, "CS8", nsPerSample, match ? "" : "  MISMATCH");
+
+        // peak (block floating point CS8)
+        match = converter.peak(xi.data(), xq.data(), numSamples) == converters.front().peak(xi.data(), xq.data(), numSamples);
+        errors += match ? 0 : 1;
+        auto peak = converter.peak;
+        nsPerSample = benchmark([peak](const short *i, const short *q, void *o, unsigned int n) { *(unsigned int *)o = peak(i, q, n); },
+                                xi.data(), xq.data(), out.data(), numSamples, iterations);
+        printf("%-8s %-6s %12.3f%s\n", converter.name, "peak", nsPerSample, match ? "" : "  MISMATCH");
+
+        // CS16 stream buffers to CF32 (readStream)
+        converters.front().cs16ToCF32(interleaved.data(), reference.data(), numSamples);
+        converter.cs16ToCF32(interleaved.data(), out.data(), numSamples);
+        match = memcmp(reference.data(), out.data(), numSamples * 2 * sizeof(float)) == 0;
+        errors += match ? 0 : 1;
+        auto cs16ToCF32 = converter.cs16ToCF32;
+        const short *in = interleaved.data();
+        nsPerSample = benchmark([cs16ToCF32, in](const short *, const short *, void *o, unsigned int n) { cs16ToCF32(in, o, n); },
+                                xi.data(), xq.data(), out.data(), numSamples, iterations);
+        printf("%-8s %-6s %12.3f%s\n", converter.name, "ring", nsPerSample, match ? "" : "  MISMATCH");
+
+        // software resampling filters, per output sample; they add up in
+        // a different order, so they only have to be close to the scalar ones
+        auto halfBand = converter.halfBand;
+        const float *x = samples.data();
+        const float *h = taps.data();
+        auto runHalfBand = [halfBand, x, h](const short *, const short *, void *o, unsigned int n)
+        {
+            halfBand(x, x + 2 * n, h, 11, 0.5f, (float *)o, n);
+        };
+        converters.front().halfBand(x, x + 2 * (numSamples / 2), h, 11, 0.5f, reference.data(), numSamples / 2);
+        runHalfBand(nullptr, nullptr, out.data(), numSamples / 2);
+        match = close(reference, out, numSamples / 2);
+        errors += match ? 0 : 1;
+        nsPerSample = benchmark(runHalfBand, xi.data(), xq.data(), out.data(), numSamples / 2, iterations);
+        printf("%-8s %-6s %12.3f%s\n", converter.name, "hband", nsPerSample, match ? "" : "  MISMATCH");
+
+        auto dot = converter.dot;
+        auto runDot = [dot, x, h](const short *, const short *, void *o, unsigned int n)
+        {
+            for (unsigned int i = 0; i < n; i++)
+            {
+                dot(h, x + 2 * i, 32, (float *)o + 2 * i);
+            }
+        };
+        for (unsigned int i = 0; i < numSamples; i++)
+        {
+            converters.front().dot(h, x + 2 * i, 32, reference.data() + 2 * i);
+        }
+        runDot(nullptr, nullptr, out.data(), numSamples);
+        match = close(reference, out, numSamples);
+        errors += match ? 0 : 1;
+        nsPerSample = benchmark(runDot, xi.data(), xq.data(), out.data(), numSamples, iterations);
+        printf("%-8s %-6s %12.3f%s\n", converter.name, "dot32", nsPerSample, match ? "" : "  MISMATCH");
+
+        // resampler input split into even and odd samples, and output
+        // back to 16 bits (past full scale too)
+        auto split = converter.split;
+        auto runSplit = [split, x](const short *, const short *, void *o, unsigned int n)
+        {
+            split(x, (float *)o, (float *)o + n + 1, n);
+        };
+        std::fill(reference.begin(), reference.end(), 0.0f);
+        std::fill(out.begin(), out.end(), 0.0f);
+        converters.front().split(x, reference.data(), reference.data() + numSamples + 1, numSamples);
+        runSplit(nullptr, nullptr, out.data(), numSamples);
+        match = memcmp(reference.data(), out.data(), reference.size() * sizeof(float)) == 0;
+        errors += match ? 0 : 1;
+        nsPerSample = benchmark(runSplit, xi.data(), xq.data(), out.data(), numSamples, iterations);
+        printf("%-8s %-6s %12.3f%s\n", converter.name, "split", nsPerSample, match ? "" : "  MISMATCH");
+
+        std::vector<float> loud(2 * numSamples);
+        for (unsigned int i = 0; i < 2 * numSamples; i++)
+        {
+            loud[i] = 2.5f * samples[i];
+        }
+        converters.front().fromCF32(loud.data(), referenceCS16.data(), referenceCS16.data() + numSamples, numSamples);
+        converter.fromCF32(loud.data(), outCS16.data(), outCS16.data() + numSamples, numSamples);
+        match = closeCS16(referenceCS16, outCS16, 2 * numSamples);
+        errors += match ? 0 : 1;
+        auto fromCF32 = converter.fromCF32;
+        const float *l = loud.data();
+        nsPerSample = benchmark([fromCF32, l](const short *, const short *, void *o, unsigned int n) { fromCF32(l, (short *)o, (short *)o + n, n); },
+                                xi.data(), xq.data(), outCS16.data(), numSamples, iterations);
+        printf("%-8s %-6s %12.3f%s\n", converter.name, "fromCF", nsPerSample, match ? "" : "  MISMATCH");
+
+        // software frequency shift, fused with CS16 and into separate I and Q
+        SoapySDRPlayNco referenceNco = { 0.25, 0.0123 };
+        SoapySDRPlayNco nco = referenceNco;
+        converters.front().mixToCS16(xi.data(), xq.data(), referenceCS16.data(), numSamples, &referenceNco);
+        converter.mixToCS16(xi.data(), xq.data(), outCS16.data(), numSamples, &nco);
+        match = closeCS16(referenceCS16, outCS16, 2 * numSamples) && std::fabs(nco.phase - referenceNco.phase) < 1e-9;
+        errors += match ? 0 : 1;
+        auto mixToCS16 = converter.mixToCS16;
+        nsPerSample = benchmark([mixToCS16, &nco](const short *i, const short *q, void *o, unsigned int n) { mixToCS16(i, q, o, n, &nco); },
+                                xi.data(), xq.data(), out.data(), numSamples, iterations);
+        printf("%-8s %-6s %12.3f%s\n", converter.name, "mix", nsPerSample, match ? "" : "  MISMATCH");
+
+        referenceNco = { 0.25, -0.0123 };
+        nco = referenceNco;
+        converters.front().mix(xi.data(), xq.data(), referenceCS16.data(), referenceCS16.data() + numSamples, numSamples, &referenceNco);
+        converter.mix(xi.data(), xq.data(), outCS16.data(), outCS16.data() + numSamples, numSamples, &nco);
+        match = closeCS16(referenceCS16, outCS16, 2 * numSamples) && std::fabs(nco.phase - referenceNco.phase) < 1e-9;
+        errors += match ? 0 : 1;
+        auto mix = converter.mix;
+        nsPerSample = benchmark([mix, &nco](const short *i, const short *q, void *o, unsigned int n) { mix(i, q, (short *)o, (short *)o + n, n, &nco); },
+                                xi.data(), xq.data(), out.data(), numSamples, iterations);
+        printf("%-8s %-6s %12.3f%s\n", converter.name, "mixIQ", nsPerSample, match ? "" : "  MISMATCH");
+    }
+
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,321 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Charles J. Cliffe
+ * Copyright (c) 2020 Franco Venturi - changes for SDRplay API version 3
+ *                                     and Dual Tuner for RSPduo
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Data path benchmark: drives SoapySDRPlay::rx_callback from a paced producer
+// thread (standing in for the SDRplay API thread) while a consumer thread
+// reads the stream, for every combination of the swept parameters, and
+// reports the throughput the consumer sustained, the samples lost to
+// overflows, and how long rx_callback took.
+// It runs the module against the mock sdrplay_api library.
+//
+// Usage: SoapySDRPlayStreamBenchmark [key=value ...]
+//  rates=2,8,32,0          offered sample rates in MS/s (0: unpaced)
+//  sizes=252,1008,2016     samples per callback
+//  formats=CS16,CF32       stream formats (CS8, CS16, CF32)
+//  consumers=read:1024,read:65536,direct
+//                          readStream() with numElems, or
+//                          acquireReadBuffer()/releaseReadBuffer()
+//                          (directaccess=false is ignored for it)
+//  duration=1              seconds per run
+//  csv=1                   comma separated output
+// any other key=value is passed to setupStream() as a stream arg
+
+#include "SoapySDRPlay.hpp"
+#include "sdrplay_api_mock.h"
+#include <SoapySDR/Errors.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct RunResult
+{
+    double deliveredRate;       // MS/s read by the consumer
+    double lostPercent;         // samples lost to overflows
+    double overflowsPerSecond;  // SOAPY_SDR_OVERFLOW returns
+    double callbackUs[4];       // p50, p99, p99.9, max
+    int error;                  // error that stopped the consumer (0 if none)
+};
+
+static std::vector<std::string> split(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        items.push_back(item);
+    }
+    return items;
+}
+
+static double percentile(std::vector<float> &values, double p)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    size_t n = std::min((size_t)(p * values.size()), values.size() - 1);
+    std::nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n];
+}
+
+static RunResult run(SoapySDRPlay &device, const std::string &format, unsigned int numSamples,
+                     const std::string &consumer, double rateMsps, double duration,
+                     const SoapySDR::Kwargs &streamArgs)
+{
+    // CF32 streams do not hand out their buffers with directaccess=false
+    const bool direct = consumer == "direct";
+    SoapySDR::Kwargs args = streamArgs;
+    if (direct)
+    {
+        args.erase("directaccess");
+    }
+    SoapySDR::Stream *stream = device.setupStream(SOAPY_SDR_RX, format, std::vector<size_t>(), args);
+    auto *sdrplayStream = reinterpret_cast<SoapySDRPlay::SoapySDRPlayStream *>(stream);
+    device.activateStream(stream);
+
+    // take the reset issued by activateStream() before the clock starts
+    std::vector<float> buff(2 * std::max(device.getStreamMTU(stream), (size_t)65536));
+    void *buffs[2] = { buff.data(), buff.data() };
+    int flags;
+    long long timeNs;
+    device.readStream(stream, buffs, 1, flags, timeNs, 0);
+
+    const size_t numElems = direct ? 0 : std::stoul(consumer.substr(consumer.find(':') + 1));
+    std::atomic_bool done(false);
+    unsigned long long delivered = 0;
+    unsigned long long overflows = 0;
+    int error = 0;
+    std::thread reader([&]
+    {
+        volatile short sink = 0;
+        while (!done)
+        {
+            int ret;
+            if (direct)
+            {
+                size_t handle;
+                const void *readBuffs[2];
+                ret = device.acquireReadBuffer(stream, handle, readBuffs, flags, timeNs, 100000);
+                if (ret > 0)
+                {
+                    sink = sink + *(const short *)readBuffs[0];
+                    device.releaseReadBuffer(stream, handle);
+                }
+            }
+            else
+            {
+                ret = device.readStream(stream, buffs, numElems, flags, timeNs, 100000);
+            }
+            if (ret > 0)
+            {
+                delivered += ret;
+            }
+            else if (ret == SOAPY_SDR_OVERFLOW)
+            {
+                overflows++;
+            }
+            else if (ret != SOAPY_SDR_TIMEOUT)
+            {
+                error = ret;
+                break;
+            }
+        }
+    });
+
+    // producer: a ramp in the layout the API delivers, paced at the offered rate
+    std::vector<short> xi(numSamples);
+    std::vector<short> xq(numSamples);
+    for (unsigned int i = 0; i < numSamples; i++)
+    {
+        xi[i] = (short)i;
+        xq[i] = (short)~i;
+    }
+    std::vector<float> callbackUs;
+    callbackUs.reserve(1 << 20);
+    sdrplay_api_StreamCbParamsT params = {};
+    params.numSamples = numSamples;
+    unsigned long long produced = 0;
+    const auto period = std::chrono::duration<double>(rateMsps > 0 ? numSamples / (rateMsps * 1e6) : 0);
+    const auto start = Clock::now();
+    const auto stop = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(duration));
+    auto next = start;
+    for (auto now = start; now < stop; now = Clock::now())
+    {
+        if (rateMsps > 0)
+        {
+            // sleep while far from the next callback, then spin
+            if (next - now > std::chrono::microseconds(200))
+            {
+                std::this_thread::sleep_until(next - std::chrono::microseconds(100));
+            }
+            while (Clock::now() < next) {}
+            next += std::chrono::duration_cast<Clock::duration>(period);
+        }
+        auto before = Clock::now();
+        device.rx_callback(xi.data(), xq.data(), &params, numSamples, 0, sdrplayStream, 0);
+        auto after = Clock::now();
+        callbackUs.push_back(std::chrono::duration<float, std::micro>(after - before).count());
+        params.firstSampleNum += numSamples;
+        produced += numSamples;
+    }
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    done = true;
+    reader.join();
+
+    RunResult result;
+    result.deliveredRate = delivered / elapsed / 1e6;
+    result.lostPercent = 100.0 * (sdrplayStream->stats.samplesDropped + sdrplayStream->stats.samplesFlushed) / std::max(produced, 1ULL);
+    result.overflowsPerSecond = overflows / elapsed;
+    result.callbackUs[0] = percentile(callbackUs, 0.5);
+    result.callbackUs[1] = percentile(callbackUs, 0.99);
+    result.callbackUs[2] = percentile(callbackUs, 0.999);
+    result.callbackUs[3] = callbackUs.empty() ? 0 : *std::max_element(callbackUs.begin(), callbackUs.end());
+    result.error = error;
+
+    device.deactivateStream(stream);
+    device.closeStream(stream);
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> rates = split("2,8,32,0");
+    std::vector<std::string> sizes = split("252,1008,2016");
+    std::vector<std::string> formats = split("CS16,CF32");
+    std::vector<std::string> consumers = split("read:1024,read:65536,direct");
+    double duration = 1;
+    bool csv = false;
+    SoapySDR::Kwargs streamArgs;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        size_t eq = arg.find('=');
+        if (eq == std::string::npos)
+        {
+            fprintf(stderr, "invalid argument '%s' - key=value expected\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        std::string key = arg.substr(0, eq);
+        std::string value = arg.substr(eq + 1);
+        if (key == "rates") rates = split(value);
+        else if (key == "sizes") sizes = split(value);
+        else if (key == "formats") formats = split(value);
+        else if (key == "consumers") consumers = split(value);
+        else if (key == "duration") duration = std::stod(value);
+        else if (key == "csv") csv = value != "0";
+        else streamArgs[key] = value;
+    }
+
+    SoapySDR_setLogLevel(SOAPY_SDR_WARNING);
+
+    // the benchmark calls rx_callback itself, so keep the mock quiet
+    SoapySDRPlay::sdrplay_api::get_instance();
+    sdrplay_api_mock_PauseStream(1);
+    sdrplay_api_DeviceT devices[SDRPLAY_MAX_DEVICES];
+    unsigned int numDevices = 0;
+    sdrplay_api_GetDevices(devices, &numDevices, SDRPLAY_MAX_DEVICES);
+    if (numDevices == 0)
+    {
+        fprintf(stderr, "no mock device\n");
+        return EXIT_FAILURE;
+    }
+    SoapySDR::Kwargs deviceArgs;
+    deviceArgs["serial"] = devices[0].SerNo;
+    SoapySDRPlay device(deviceArgs);
+    int errors = 0;
+
+    if (csv)
+    {
+        printf("format,size,consumer,offered_msps,delivered_msps,lost_percent,overflows_per_s,cb_p50_us,cb_p99_us,cb_p999_us,cb_max_us\n");
+    }
+    else
+    {
+        printf("%-6s %6s %-12s %9s %9s %8s %8s %8s %8s %8s %8s\n", "format", "size", "consumer",
+               "offered", "MS/s", "lost%", "ovf/s", "cb p50", "cb p99", "cb p99.9", "cb max");
+    }
+    for (const auto &format : formats)
+    {
+        for (const auto &size : sizes)
+        {
+            for (const auto &consumer : consumers)
+            {
+                // the highest offered rate read without losing samples
+                double sustained = -1;
+                for (const auto &rate : rates)
+                {
+                    double rateMsps = std::stod(rate);
+                    RunResult r = run(device, format, (unsigned int)std::stoul(size), consumer, rateMsps, duration, streamArgs);
+                    if (r.error != 0)
+                    {
+                        fprintf(stderr, "%s %s %s %s: consumer stopped by error %d (%s)\n", format.c_str(), size.c_str(),
+                                consumer.c_str(), rate.c_str(), r.error, SoapySDR_errToStr(r.error));
+                        errors++;
+                        continue;
+                    }
+                    if (r.lostPercent == 0 && rateMsps > 0)
+                    {
+                        sustained = std::max(sustained, rateMsps);
+                    }
+                    if (r.lostPercent == 0 && rateMsps == 0)
+                    {
+                        sustained = std::max(sustained, r.deliveredRate);
+                    }
+                    if (csv)
+                    {
+                        printf("%s,%s,%s,%s,%.3f,%.4f,%.1f,%.3f,%.3f,%.3f,%.3f\n", format.c_str(), size.c_str(), consumer.c_str(),
+                               rate.c_str(), r.deliveredRate, r.lostPercent, r.overflowsPerSecond,
+                               r.callbackUs[0], r.callbackUs[1], r.callbackUs[2], r.callbackUs[3]);
+                    }
+                    else
+                    {
+                        printf("%-6s %6s %-12s %9s %9.2f %8.3f %8.1f %8.2f %8.2f %8.2f %8.2f\n", format.c_str(), size.c_str(), consumer.c_str(),
+                               rateMsps > 0 ? rate.c_str() : "max", r.deliveredRate, r.lostPercent, r.overflowsPerSecond,
+                               r.callbackUs[0], r.callbackUs[1], r.callbackUs[2], r.callbackUs[3]);
+                    }
+                    fflush(stdout);
+                }
+                if (!csv)
+                {
+                    if (sustained < 0)
+                        printf("  -> no loss-free rate\n");
+                    else
+                        printf("  -> sustained without loss: %.2f MS/s\n", sustained);
+                }
+            }
+        }
+    }
+
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
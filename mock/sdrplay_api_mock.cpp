@@ -0,0 +1,764 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Charles J. Cliffe
+ * Copyright (c) 2020 Franco Venturi - changes for SDRplay API version 3
+ *                                     and Dual Tuner for RSPduo
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Stand-in for the SDRplay API library (USE_MOCK_SDRPLAY_API build option):
+// a few simulated RSPs that stream a ramp from one thread per device at a
+// configurable rate, and report updates and events the way the service does.
+// See sdrplay_api_mock.h for the configuration.
+
+#include "sdrplay_api_mock.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct MockEvent
+{
+    sdrplay_api_EventT eventId;
+    sdrplay_api_TunerSelectT tuner;
+    sdrplay_api_EventParamsT params;
+};
+
+struct MockDevice
+{
+    // as listed by sdrplay_api_GetDevices()
+    sdrplay_api_DeviceT info;
+    bool selected;
+    sdrplay_api_TunerSelectT tuner;
+    sdrplay_api_RspDuoModeT rspDuoMode;
+
+    sdrplay_api_DevParamsT devParams;
+    sdrplay_api_RxChannelParamsT rxChannelA;
+    sdrplay_api_RxChannelParamsT rxChannelB;
+    sdrplay_api_DeviceParamsT deviceParams;
+
+    // streaming thread
+    std::thread thread;
+    std::atomic_bool running;
+    sdrplay_api_CallbackFnsT callbackFns;
+    void *cbContext;
+
+    // what the next callbacks report (protected by the mock mutex);
+    // pending updates count down the callbacks left (-1: none)
+    int pendingGr[2];
+    int pendingRf[2];
+    int pendingFs[2];
+    int forcedChanged[3];
+    std::vector<MockEvent> events;
+    unsigned int skip;
+    bool reset;
+};
+
+struct Mock
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<MockDevice>> devices;
+    bool open = false;
+    double sampleRate = -1;
+    unsigned int samplesPerCallback = 1008;
+    unsigned int updateDelay = 1;
+    double initDelayMs = 0;
+    bool reportUpdates = true;
+    unsigned int stopPending = 0;
+    std::atomic_bool paused;
+    std::atomic<unsigned long long> callbackCount;
+};
+
+Mock &mock()
+{
+    static Mock instance;
+    return instance;
+}
+
+MockDevice *findDevice(HANDLE dev)
+{
+    for (auto &device : mock().devices)
+    {
+        if ((HANDLE)device.get() == dev)
+        {
+            return device.get();
+        }
+    }
+    return nullptr;
+}
+
+unsigned char modelToHwVer(const std::string &model)
+{
+    if (model == "RSP1")     return SDRPLAY_RSP1_ID;
+    if (model == "RSP1A")    return SDRPLAY_RSP1A_ID;
+    if (model == "RSP1B")    return SDRPLAY_RSP1B_ID;
+    if (model == "RSP2")     return SDRPLAY_RSP2_ID;
+    if (model == "RSPduo")   return SDRPLAY_RSPduo_ID;
+    if (model == "RSPdx")    return SDRPLAY_RSPdx_ID;
+    if (model == "RSPdx-R2") return SDRPLAY_RSPdxR2_ID;
+    return 0;
+}
+
+void addDevice(unsigned char hwVer)
+{
+    std::unique_ptr<MockDevice> device(new MockDevice());
+    std::memset(&device->info, 0, sizeof(device->info));
+    std::snprintf(device->info.SerNo, sizeof(device->info.SerNo), "MOCK%04u", (unsigned int)mock().devices.size());
+    device->info.hwVer = hwVer;
+    device->info.valid = 1;
+    if (hwVer == SDRPLAY_RSPduo_ID)
+    {
+        device->info.tuner = sdrplay_api_Tuner_Both;
+        device->info.rspDuoMode = (sdrplay_api_RspDuoModeT)(sdrplay_api_RspDuoMode_Single_Tuner |
+                                                            sdrplay_api_RspDuoMode_Dual_Tuner |
+                                                            sdrplay_api_RspDuoMode_Master);
+    }
+    else
+    {
+        device->info.tuner = sdrplay_api_Tuner_A;
+        device->info.rspDuoMode = sdrplay_api_RspDuoMode_Unknown;
+    }
+    device->info.dev = (HANDLE)device.get();
+    device->selected = false;
+    device->running = false;
+    mock().devices.push_back(std::move(device));
+}
+
+// the API defaults
+void setDefaultParams(MockDevice *device)
+{
+    std::memset(&device->devParams, 0, sizeof(device->devParams));
+    device->devParams.fsFreq.fsHz = 2000000;
+    device->devParams.mode = sdrplay_api_ISOCH;
+    device->devParams.samplesPerPkt = mock().samplesPerCallback;
+
+    sdrplay_api_RxChannelParamsT channel;
+    std::memset(&channel, 0, sizeof(channel));
+    channel.tunerParams.bwType = sdrplay_api_BW_0_200;
+    channel.tunerParams.ifType = sdrplay_api_IF_Zero;
+    channel.tunerParams.loMode = sdrplay_api_LO_Auto;
+    channel.tunerParams.gain.gRdB = 50;
+    channel.tunerParams.gain.LNAstate = 0;
+    channel.tunerParams.gain.minGr = sdrplay_api_NORMAL_MIN_GR;
+    channel.tunerParams.rfFreq.rfHz = 200000000;
+    channel.tunerParams.dcOffsetTuner.dcCal = 3;
+    channel.tunerParams.dcOffsetTuner.trackTime = 1;
+    channel.ctrlParams.dcOffset.DCenable = 1;
+    channel.ctrlParams.dcOffset.IQenable = 1;
+    channel.ctrlParams.decimation.enable = 0;
+    channel.ctrlParams.decimation.decimationFactor = 1;
+    channel.ctrlParams.agc.enable = sdrplay_api_AGC_50HZ;
+    channel.ctrlParams.agc.setPoint_dBfs = -60;
+
+    // the RSPduo modes other than single tuner run at a fixed
+    // sample rate with a low IF
+    if (device->rspDuoMode == sdrplay_api_RspDuoMode_Dual_Tuner ||
+        device->rspDuoMode == sdrplay_api_RspDuoMode_Master)
+    {
+        double rspDuoSampleFreq = device->info.rspDuoSampleFreq != 0 ? device->info.rspDuoSampleFreq : 6000000;
+        device->devParams.fsFreq.fsHz = rspDuoSampleFreq;
+        channel.tunerParams.bwType = sdrplay_api_BW_1_536;
+        channel.tunerParams.ifType = rspDuoSampleFreq == 8000000 ? sdrplay_api_IF_2_048 : sdrplay_api_IF_1_620;
+    }
+
+    device->rxChannelA = channel;
+    device->rxChannelB = channel;
+    device->deviceParams.devParams = &device->devParams;
+    device->deviceParams.rxChannelA = &device->rxChannelA;
+    device->deviceParams.rxChannelB = device->rspDuoMode == sdrplay_api_RspDuoMode_Dual_Tuner ? &device->rxChannelB : nullptr;
+    if (device->tuner == sdrplay_api_Tuner_B)
+    {
+        device->deviceParams.rxChannelA = nullptr;
+        device->deviceParams.rxChannelB = &device->rxChannelB;
+    }
+}
+
+const sdrplay_api_RxChannelParamsT &activeChannel(const MockDevice *device)
+{
+    return device->tuner == sdrplay_api_Tuner_B ? device->rxChannelB : device->rxChannelA;
+}
+
+unsigned int decimationFactor(const MockDevice *device)
+{
+    const sdrplay_api_DecimationT &decimation = activeChannel(device).ctrlParams.decimation;
+    return decimation.enable ? decimation.decimationFactor : 1;
+}
+
+// the output sample rate of the current configuration
+double outputSampleRate(const MockDevice *device)
+{
+    double rate = device->devParams.fsFreq.fsHz;
+    // low IF signals are brought down to baseband by the API
+    switch (activeChannel(device).tunerParams.ifType)
+    {
+        case sdrplay_api_IF_1_620: rate /= 3; break;
+        case sdrplay_api_IF_2_048: rate /= 4; break;
+        case sdrplay_api_IF_0_450: rate /= 4; break;
+        default: break;
+    }
+    return rate / decimationFactor(device);
+}
+
+// count down a pending update; true when this callback reports it
+bool reportNow(int &pending)
+{
+    if (pending < 0)
+    {
+        return false;
+    }
+    if (pending == 0)
+    {
+        pending = -1;
+        return true;
+    }
+    pending--;
+    return false;
+}
+
+void streamThread(MockDevice *device)
+{
+    const bool dualTuner = device->rspDuoMode == sdrplay_api_RspDuoMode_Dual_Tuner;
+    std::vector<short> xi;
+    std::vector<short> xq;
+    unsigned int sampleNum = 0;
+    unsigned short ramp = 0;
+    bool reset = true;
+    double initDelayMs;
+    {
+        std::lock_guard<std::mutex> lock(mock().mutex);
+        initDelayMs = mock().initDelayMs;
+    }
+    auto next = std::chrono::steady_clock::now() +
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double, std::milli>(initDelayMs));
+    std::this_thread::sleep_until(next);
+
+    while (device->running)
+    {
+        if (mock().paused)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            next = std::chrono::steady_clock::now();
+            continue;
+        }
+
+        sdrplay_api_StreamCbParamsT params[2];
+        std::memset(params, 0, sizeof(params));
+        std::vector<MockEvent> events;
+        unsigned int numSamples;
+        unsigned int decimation;
+        double rate;
+        {
+            std::lock_guard<std::mutex> lock(mock().mutex);
+            numSamples = mock().samplesPerCallback;
+            decimation = decimationFactor(device);
+            rate = mock().sampleRate < 0 ? outputSampleRate(device) : mock().sampleRate;
+
+            sampleNum += device->skip * decimation;
+            ramp += (unsigned short)device->skip;
+            device->skip = 0;
+            reset = reset || device->reset;
+            device->reset = false;
+
+            for (int t = 0; t < 2; ++t)
+            {
+                params[t].grChanged = reportNow(device->pendingGr[t]) || device->forcedChanged[0];
+                params[t].rfChanged = reportNow(device->pendingRf[t]) || device->forcedChanged[1];
+                params[t].fsChanged = reportNow(device->pendingFs[t]) || device->forcedChanged[2];
+            }
+            std::memset(device->forcedChanged, 0, sizeof(device->forcedChanged));
+            events.swap(device->events);
+        }
+
+        for (auto &event : events)
+        {
+            device->callbackFns.EventCbFn(event.eventId, event.tuner, &event.params, device->cbContext);
+        }
+
+        xi.resize(numSamples);
+        xq.resize(numSamples);
+        for (unsigned int i = 0; i < numSamples; ++i)
+        {
+            xi[i] = (short)(unsigned short)(ramp + i);
+            xq[i] = (short)~(unsigned short)(ramp + i);
+        }
+        for (int t = 0; t < 2; ++t)
+        {
+            params[t].firstSampleNum = sampleNum;
+            params[t].numSamples = numSamples;
+        }
+
+        device->callbackFns.StreamACbFn(xi.data(), xq.data(), &params[0], numSamples, reset, device->cbContext);
+        if (dualTuner)
+        {
+            device->callbackFns.StreamBCbFn(xi.data(), xq.data(), &params[1], numSamples, reset, device->cbContext);
+        }
+        mock().callbackCount++;
+        reset = false;
+        sampleNum += numSamples * decimation;
+        ramp += (unsigned short)numSamples;
+
+        // pace the callbacks; after a long stall start over
+        // rather than trying to catch up
+        if (rate > 0)
+        {
+            next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::duration<double>(numSamples / rate));
+            auto now = std::chrono::steady_clock::now();
+            if (next < now - std::chrono::seconds(1))
+            {
+                next = now;
+            }
+            std::this_thread::sleep_until(next);
+        }
+    }
+}
+
+void stopStreaming(MockDevice *device)
+{
+    if (device->thread.joinable())
+    {
+        device->running = false;
+        device->thread.join();
+    }
+}
+
+} // namespace
+
+/*******************************************************************
+ * sdrplay_api functions
+ ******************************************************************/
+
+sdrplay_api_ErrT sdrplay_api_Open(void)
+{
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    if (mock().open)
+    {
+        return sdrplay_api_Success;
+    }
+    mock().open = true;
+    mock().paused = false;
+    mock().callbackCount = 0;
+
+    const char *value;
+    if ((value = std::getenv("SDRPLAY_MOCK_SAMPLE_RATE")) != nullptr)
+    {
+        mock().sampleRate = std::atof(value);
+    }
+    if ((value = std::getenv("SDRPLAY_MOCK_SAMPLES_PER_CALLBACK")) != nullptr && std::atoi(value) > 0)
+    {
+        mock().samplesPerCallback = (unsigned int)std::atoi(value);
+    }
+    if ((value = std::getenv("SDRPLAY_MOCK_UPDATE_DELAY")) != nullptr)
+    {
+        mock().updateDelay = (unsigned int)std::atoi(value);
+    }
+    if ((value = std::getenv("SDRPLAY_MOCK_INIT_DELAY")) != nullptr)
+    {
+        mock().initDelayMs = std::atof(value);
+    }
+
+    std::string models = "RSP1A";
+    if ((value = std::getenv("SDRPLAY_MOCK_DEVICES")) != nullptr)
+    {
+        models = value;
+    }
+    std::stringstream modelList(models);
+    std::string model;
+    while (std::getline(modelList, model, ',') && mock().devices.size() < SDRPLAY_MAX_DEVICES)
+    {
+        unsigned char hwVer = modelToHwVer(model);
+        if (hwVer == 0)
+        {
+            std::fprintf(stderr, "sdrplay_api mock: unknown model '%s'\n", model.c_str());
+            continue;
+        }
+        addDevice(hwVer);
+    }
+    return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_Close(void)
+{
+    std::vector<std::unique_ptr<MockDevice>> devices;
+    {
+        std::lock_guard<std::mutex> lock(mock().mutex);
+        if (!mock().open)
+        {
+            return sdrplay_api_NotInitialised;
+        }
+        mock().open = false;
+        devices.swap(mock().devices);
+    }
+    for (auto &device : devices)
+    {
+        stopStreaming(device.get());
+    }
+    return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_ApiVersion(float *apiVer)
+{
+    *apiVer = SDRPLAY_API_VERSION;
+    return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_LockDeviceApi(void)
+{
+    return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_UnlockDeviceApi(void)
+{
+    return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_GetDevices(sdrplay_api_DeviceT *devices, unsigned int *numDevs, unsigned int maxDevs)
+{
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    unsigned int n = 0;
+    for (auto &device : mock().devices)
+    {
+        if (n == maxDevs)
+        {
+            break;
+        }
+        // a selected device is no longer available
+        if (device->selected)
+        {
+            continue;
+        }
+        devices[n++] = device->info;
+    }
+    *numDevs = n;
+    return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_SelectDevice(sdrplay_api_DeviceT *device)
+{
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    MockDevice *mockDevice = findDevice(device->dev);
+    if (mockDevice == nullptr)
+    {
+        return sdrplay_api_InvalidParam;
+    }
+    if (mockDevice->selected)
+    {
+        return sdrplay_api_Fail;
+    }
+    mockDevice->selected = true;
+    if (mockDevice->info.hwVer == SDRPLAY_RSPduo_ID)
+    {
+        mockDevice->rspDuoMode = device->rspDuoMode;
+        mockDevice->tuner = device->rspDuoMode == sdrplay_api_RspDuoMode_Dual_Tuner ? sdrplay_api_Tuner_Both : device->tuner;
+        mockDevice->info.rspDuoSampleFreq = device->rspDuoSampleFreq;
+    }
+    else
+    {
+        mockDevice->rspDuoMode = sdrplay_api_RspDuoMode_Unknown;
+        mockDevice->tuner = sdrplay_api_Tuner_A;
+    }
+    setDefaultParams(mockDevice);
+    device->tuner = mockDevice->tuner;
+    return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_ReleaseDevice(sdrplay_api_DeviceT *device)
+{
+    MockDevice *mockDevice;
+    {
+        std::lock_guard<std::mutex> lock(mock().mutex);
+        mockDevice = findDevice(device->dev);
+        if (mockDevice == nullptr || !mockDevice->selected)
+        {
+            return sdrplay_api_InvalidParam;
+        }
+    }
+    stopStreaming(mockDevice);
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    mockDevice->selected = false;
+    return sdrplay_api_Success;
+}
+
+const char *sdrplay_api_GetErrorString(sdrplay_api_ErrT err)
+{
+    switch (err)
+    {
+        case sdrplay_api_Success:          return "sdrplay_api_Success";
+        case sdrplay_api_Fail:             return "sdrplay_api_Fail";
+        case sdrplay_api_InvalidParam:     return "sdrplay_api_InvalidParam";
+        case sdrplay_api_OutOfRange:       return "sdrplay_api_OutOfRange";
+        case sdrplay_api_AlreadyInitialised: return "sdrplay_api_AlreadyInitialised";
+        case sdrplay_api_NotInitialised:   return "sdrplay_api_NotInitialised";
+        case sdrplay_api_StopPending:      return "sdrplay_api_StopPending";
+        default:                           return "sdrplay_api mock error";
+    }
+}
+
+sdrplay_api_ErrT sdrplay_api_DebugEnable(HANDLE dev, sdrplay_api_DbgLvl_t enable)
+{
+    return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_GetDeviceParams(HANDLE dev, sdrplay_api_DeviceParamsT **deviceParams)
+{
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    MockDevice *device = findDevice(dev);
+    if (device == nullptr || !device->selected)
+    {
+        return sdrplay_api_InvalidParam;
+    }
+    *deviceParams = &device->deviceParams;
+    return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_Init(HANDLE dev, sdrplay_api_CallbackFnsT *callbackFns, void *cbContext)
+{
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    MockDevice *device = findDevice(dev);
+    if (device == nullptr || !device->selected)
+    {
+        return sdrplay_api_InvalidParam;
+    }
+    if (device->running)
+    {
+        return sdrplay_api_AlreadyInitialised;
+    }
+    device->callbackFns = *callbackFns;
+    device->cbContext = cbContext;
+    for (int t = 0; t < 2; ++t)
+    {
+        device->pendingGr[t] = -1;
+        device->pendingRf[t] = -1;
+        device->pendingFs[t] = -1;
+    }
+    std::memset(device->forcedChanged, 0, sizeof(device->forcedChanged));
+    device->events.clear();
+    device->skip = 0;
+    device->reset = false;
+    device->running = true;
+    device->thread = std::thread(streamThread, device);
+    return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_Uninit(HANDLE dev)
+{
+    MockDevice *device;
+    {
+        std::lock_guard<std::mutex> lock(mock().mutex);
+        device = findDevice(dev);
+        if (device == nullptr || !device->running)
+        {
+            return sdrplay_api_NotInitialised;
+        }
+        if (mock().stopPending != 0)
+        {
+            mock().stopPending--;
+            return sdrplay_api_StopPending;
+        }
+    }
+    stopStreaming(device);
+    return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_Update(HANDLE dev, sdrplay_api_TunerSelectT tuner,
+                                    sdrplay_api_ReasonForUpdateT reasonForUpdate,
+                                    sdrplay_api_ReasonForUpdateExtension1T reasonForUpdateExt1)
+{
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    MockDevice *device = findDevice(dev);
+    if (device == nullptr || !device->running)
+    {
+        return sdrplay_api_NotInitialised;
+    }
+    if (!mock().reportUpdates)
+    {
+        return sdrplay_api_Success;
+    }
+    const int delay = (int)mock().updateDelay;
+    for (int t = 0; t < 2; ++t)
+    {
+        if (!(tuner & (t == 0 ? sdrplay_api_Tuner_A : sdrplay_api_Tuner_B)))
+        {
+            continue;
+        }
+        if (reasonForUpdate & sdrplay_api_Update_Tuner_Gr)
+        {
+            device->pendingGr[t] = delay;
+        }
+        if (reasonForUpdate & sdrplay_api_Update_Tuner_Frf)
+        {
+            device->pendingRf[t] = delay;
+        }
+        if (reasonForUpdate & sdrplay_api_Update_Dev_Fs)
+        {
+            device->pendingFs[t] = delay;
+        }
+    }
+    return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_SwapRspDuoActiveTuner(HANDLE dev, sdrplay_api_TunerSelectT *currentTuner,
+                                                   sdrplay_api_RspDuo_AmPortSelectT tuner1AmPortSel)
+{
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    MockDevice *device = findDevice(dev);
+    if (device == nullptr || device->rspDuoMode != sdrplay_api_RspDuoMode_Single_Tuner)
+    {
+        return sdrplay_api_InvalidParam;
+    }
+    // the parameters of the tuner going active follow the current ones
+    if (device->tuner == sdrplay_api_Tuner_A)
+    {
+        device->rxChannelB = device->rxChannelA;
+        device->tuner = sdrplay_api_Tuner_B;
+        device->deviceParams.rxChannelA = nullptr;
+        device->deviceParams.rxChannelB = &device->rxChannelB;
+    }
+    else
+    {
+        device->rxChannelA = device->rxChannelB;
+        device->tuner = sdrplay_api_Tuner_A;
+        device->deviceParams.rxChannelA = &device->rxChannelA;
+        device->deviceParams.rxChannelB = nullptr;
+    }
+    device->rxChannelA.rspDuoTunerParams.tuner1AmPortSel = tuner1AmPortSel;
+    *currentTuner = device->tuner;
+    return sdrplay_api_Success;
+}
+
+/*******************************************************************
+ * Mock controls
+ ******************************************************************/
+
+void sdrplay_api_mock_SetSampleRate(double sampleRate)
+{
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    mock().sampleRate = sampleRate;
+}
+
+void sdrplay_api_mock_SetSamplesPerCallback(unsigned int numSamples)
+{
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    if (numSamples > 0)
+    {
+        mock().samplesPerCallback = numSamples;
+    }
+}
+
+void sdrplay_api_mock_PauseStream(int pause)
+{
+    mock().paused = pause != 0;
+}
+
+void sdrplay_api_mock_SetUpdateDelay(unsigned int numCallbacks, int report)
+{
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    mock().updateDelay = numCallbacks;
+    mock().reportUpdates = report != 0;
+}
+
+void sdrplay_api_mock_SetInitDelay(double delayMs)
+{
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    mock().initDelayMs = delayMs;
+}
+
+void sdrplay_api_mock_ReportChanged(int grChanged, int rfChanged, int fsChanged)
+{
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    for (auto &device : mock().devices)
+    {
+        if (device->running)
+        {
+            device->forcedChanged[0] |= grChanged;
+            device->forcedChanged[1] |= rfChanged;
+            device->forcedChanged[2] |= fsChanged;
+        }
+    }
+}
+
+void sdrplay_api_mock_SendEvent(sdrplay_api_EventT eventId,
+                                sdrplay_api_TunerSelectT tuner,
+                                const sdrplay_api_EventParamsT *params)
+{
+    MockEvent event;
+    std::memset(&event, 0, sizeof(event));
+    event.eventId = eventId;
+    event.tuner = tuner;
+    if (params != nullptr)
+    {
+        event.params = *params;
+    }
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    for (auto &device : mock().devices)
+    {
+        if (device->running)
+        {
+            device->events.push_back(event);
+        }
+    }
+}
+
+void sdrplay_api_mock_SkipSamples(unsigned int numSamples)
+{
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    for (auto &device : mock().devices)
+    {
+        if (device->running)
+        {
+            device->skip += numSamples;
+        }
+    }
+}
+
+void sdrplay_api_mock_ResetStream(void)
+{
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    for (auto &device : mock().devices)
+    {
+        if (device->running)
+        {
+            device->reset = true;
+        }
+    }
+}
+
+void sdrplay_api_mock_SetStopPending(unsigned int count)
+{
+    std::lock_guard<std::mutex> lock(mock().mutex);
+    mock().stopPending = count;
+}
+
+unsigned long long sdrplay_api_mock_GetCallbackCount(void)
+{
+    return mock().callbackCount;
+}
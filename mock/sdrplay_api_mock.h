@@ -0,0 +1,99 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Charles J. Cliffe
+ * Copyright (c) 2020 Franco Venturi - changes for SDRplay API version 3
+ *                                     and Dual Tuner for RSPduo
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+// Controls for the mock sdrplay_api library (USE_MOCK_SDRPLAY_API build
+// option), which stands in for the SDRplay API service so that the module
+// can be run and benchmarked without an RSP.
+//
+// The mock streams a ramp: xi counts the samples delivered (modulo 2^16)
+// and xq is its bitwise complement; firstSampleNum advances by the number
+// of samples before decimation, as with the real hardware.
+//
+// The initial configuration comes from these environment variables, read
+// by sdrplay_api_Open():
+//  - SDRPLAY_MOCK_DEVICES: comma separated list of models (RSP1, RSP1A,
+//    RSP1B, RSP2, RSPduo, RSPdx, RSPdx-R2); default RSP1A
+//  - SDRPLAY_MOCK_SAMPLE_RATE: rate at which the samples are delivered;
+//    0 delivers them as fast as the callbacks return; by default the
+//    output sample rate of the device configuration is used
+//  - SDRPLAY_MOCK_SAMPLES_PER_CALLBACK: default 1008
+//  - SDRPLAY_MOCK_UPDATE_DELAY: number of callbacks before an update is
+//    reported with grChanged/rfChanged/fsChanged; default 1
+//  - SDRPLAY_MOCK_INIT_DELAY: time from sdrplay_api_Init() to the first
+//    callback in ms; default 0
+//
+// The functions below change the behavior while streaming; they apply to
+// every device streaming from the next callback on.
+
+#include <sdrplay_api.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// delivery rate in samples per second (0: as fast as possible,
+// a negative value: the output sample rate of the device configuration)
+void sdrplay_api_mock_SetSampleRate(double sampleRate);
+
+void sdrplay_api_mock_SetSamplesPerCallback(unsigned int numSamples);
+
+// stop (pause != 0) or restart the stream callbacks without uninitialising
+// the device, e.g. to drive rx_callback from the caller's own thread
+void sdrplay_api_mock_PauseStream(int pause);
+
+// number of callbacks between sdrplay_api_Update() and the callback
+// reporting it; with report == 0 updates are never reported
+void sdrplay_api_mock_SetUpdateDelay(unsigned int numCallbacks, int report);
+
+// time from sdrplay_api_Init() to the first callback
+void sdrplay_api_mock_SetInitDelay(double delayMs);
+
+// set grChanged/rfChanged/fsChanged in the next callback
+void sdrplay_api_mock_ReportChanged(int grChanged, int rfChanged, int fsChanged);
+
+// deliver an event from the streaming thread before the next callback
+void sdrplay_api_mock_SendEvent(sdrplay_api_EventT eventId,
+                                sdrplay_api_TunerSelectT tuner,
+                                const sdrplay_api_EventParamsT *params);
+
+// drop numSamples samples (as lost on USB) before the next callback
+void sdrplay_api_mock_SkipSamples(unsigned int numSamples);
+
+// set the reset argument in the next callback
+void sdrplay_api_mock_ResetStream(void);
+
+// make the next count sdrplay_api_Uninit() calls fail with
+// sdrplay_api_StopPending (an RSPduo slave still streaming), and the
+// device keep streaming
+void sdrplay_api_mock_SetStopPending(unsigned int count);
+
+// number of stream callbacks delivered so far (tuner A only)
+unsigned long long sdrplay_api_mock_GetCallbackCount(void);
+
+#ifdef __cplusplus
+}
+#endif